@@ -0,0 +1,178 @@
+`timescale 1ns / 1ps
+`include "xversat.vh"
+`include "xdefs.vh"
+`include "xmemdefs.vh"
+`include "versat-io.vh"
+`include "xaludefs.vh"
+`include "xalulitedefs.vh"
+`include "xmuldefs.vh"
+`include "xmuladddefs.vh"
+`include "xbsdefs.vh"
+`include "xconfdefs.vh"
+
+//
+// Co-simulation testbench of the PC simulator (software/pc/cosim)
+// Applies the CPU writes of stim.hex, {addr, data} per line, and for every
+// run marker ({32'hFFFFFFFF, 1}) runs the configuration written so far:
+//   rtl_bus.hex: the databus of all stages at every cycle from the run write
+//                until TAIL cycles after done, stage 0 first
+//   rtl_mem.hex: all the memories after the run, stage major, one word per line
+// Each run starts with a "# run <n>" line in both files.
+// The marker {32'hFFFFFFFF, 0} ends the simulation.
+// Untested: not yet run with Icarus against the C++ model.
+//
+module xversat_cosim_tb;
+
+   parameter			ADDR_W = 32;
+   parameter			DATA_W = 32;
+
+   //parameters
+   parameter 			clk_per     = 10;
+   parameter			STIM_MAX    = 1<<18;
+   parameter			TAIL        = 16;
+   parameter			MAX_CYCLES  = 1<<20;
+   parameter			RUN_DONE    = (1<<(`nMEM_W+`MEM_ADDR_W));
+   parameter			MARK        = 32'hFFFFFFFF;
+
+   //inputs
+   reg 			   	clk;
+   reg 			   	rst;
+
+   //data/ctr interface
+   reg 			   	    valid;
+   reg [ADDR_W-1:0]  	addr;
+   reg 			   	    we;
+   reg [DATA_W-1:0]     rdata;
+   wire				    ready;
+   wire [DATA_W-1:0]    wdata;
+
+   //integer variables
+   integer i, j, k, cycles, run_cnt = 0, bus_f, mem_f;
+   reg [DATA_W-1:0] res;
+   reg [2*DATA_W-1:0] stim [STIM_MAX-1:0];
+   reg                sampling = 0;
+
+   // Instantiate the Unit Under Test (UUT)
+   xversat #(
+	     .ADDR_W(ADDR_W),
+	     .DATA_W(DATA_W)
+            )
+	uut (
+	     .clk(clk),
+	     .rst(rst),
+	     .valid(valid),
+	     .addr(addr),
+	     .we(we),
+	     .rdata(rdata),
+	     .ready(ready),
+	     .wdata(wdata)
+	     );
+
+   //databus of all stages, stage 0 in the MSBs
+   wire [`nSTAGE*`DATABUS_W-1:0] all_bus;
+   genvar g;
+   generate
+      for (g=0; g < `nSTAGE; g=g+1) begin : bus_array
+         assign all_bus[(`nSTAGE-g)*`DATABUS_W-1 -: `DATABUS_W] = uut.stage_databus[g+1];
+      end
+   endgenerate
+
+   //values after each clock edge of a run
+   always @ (posedge clk)
+     if (sampling)
+       $fstrobe(bus_f, "%h", all_bus);
+
+   initial begin
+
+`ifdef DEBUG
+      $dumpfile("xversat.vcd");
+      $dumpvars();
+`endif
+
+      $readmemh("stim.hex", stim);
+      bus_f = $fopen("rtl_bus.hex", "w");
+      mem_f = $fopen("rtl_mem.hex", "w");
+
+      //initialize inputs
+      clk = 0;
+      rst = 1;
+      valid = 0;
+      we = 0;
+      addr = 0;
+      rdata = 0;
+
+      // Wait 100 ns for global reset to finish
+      #(clk_per*10) rst = 0;
+
+      for (i = 0; i < STIM_MAX && stim[i] !== {MARK, 32'd0}; i++) begin
+         if (stim[i] !== {MARK, 32'd1})
+           cpu_write(stim[i][2*DATA_W-1 -: ADDR_W], stim[i][DATA_W-1:0]);
+         else begin
+            $fdisplay(bus_f, "# run %0d", run_cnt);
+            $fdisplay(mem_f, "# run %0d", run_cnt);
+
+            //run, sampling from its clock edge
+            sampling = 1;
+            cpu_write(RUN_DONE, 1);
+
+            //wait until done, then for the outputs to settle
+            cycles = 0;
+            do begin
+               cpu_read(RUN_DONE, res);
+               cycles++;
+            end while (res == 0 && cycles < MAX_CYCLES);
+            if (res == 0) $display("Run %0d not done after %0d polls", run_cnt, MAX_CYCLES);
+            #(clk_per*TAIL) sampling = 0;
+
+            //memory contents
+            for (j = 0; j < `nSTAGE; j++)
+              for (k = 0; k < `nMEM*(1<<`MEM_ADDR_W); k++) begin
+                 cpu_read((j<<(`CTR_ADDR_W-`nSTAGE_W)) + (k/(1<<`MEM_ADDR_W)<<`MEM_ADDR_W) + k%(1<<`MEM_ADDR_W), res);
+                 $fdisplay(mem_f, "%h", res[`DATAPATH_W-1:0]);
+              end
+            run_cnt++;
+         end
+      end
+
+      $fclose(bus_f);
+      $fclose(mem_f);
+      $display("\nCo-simulation: %0d runs dumped\n", run_cnt);
+      $finish;
+
+   end // initial begin
+
+   // Clock generation
+   always
+     #(clk_per/2) clk = ~clk;
+
+   //
+   // CPU TASKS
+   //
+
+   task cpu_write;
+      input [ADDR_W-1:0] cpu_address;
+      input [DATA_W-1:0] cpu_data;
+      addr = cpu_address;
+      valid = 1;
+      we = 1;
+      rdata = cpu_data;
+      #clk_per;
+      we = 0;
+      valid = 0;
+      #clk_per;
+   endtask
+
+   task cpu_read;
+      input [ADDR_W-1:0] cpu_address;
+      output [DATA_W-1:0] read_reg;
+      addr = cpu_address;
+      valid = 1;
+      we = 0;
+      if(addr[`nMEM_W+`MEM_ADDR_W+1 -: 2] == 2'b0) #(clk_per*`MEMP_LAT); //wait 2 cycles if addressing mem
+      else #clk_per;
+      read_reg = wdata;
+      valid = 0;
+      #clk_per;
+   endtask
+
+endmodule
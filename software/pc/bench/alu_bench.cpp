@@ -0,0 +1,250 @@
+//
+// ALU/ALULite kernels against the former std::bitset implementation
+// for every function and DATAPATH_W 8, 16 and 32: the operands on which
+// the results differ, where the former ones were not bit exact with
+// xalu.v/xalulite.v, and the ns per operation of both, which are on par
+// except for SEXT8
+//
+#include "alu_kernels.hpp"
+#include <bitset>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+#define N_OPS (1 << 12)
+#define N_REPS 500
+#define N_TRIALS 5
+
+template <typename T>
+struct CBenchTypes;
+template <>
+struct CBenchTypes<int8_t>
+{
+    typedef uint16_t shift_t;
+};
+template <>
+struct CBenchTypes<int16_t>
+{
+    typedef uint32_t shift_t;
+};
+template <>
+struct CBenchTypes<int32_t>
+{
+    typedef uint64_t shift_t;
+};
+
+//former CALU::output(), ina from opb and inb from opa
+template <typename T>
+T bitset_alu(int fns, T inb, T ina)
+{
+    const int W = sizeof(T) * 8;
+    typedef typename CBenchTypes<T>::shift_t shift_t;
+    bitset<W> aux_sext;
+    bitset<W> aux_cmp;
+    uint8_t aux_a = ina;
+    bool val;
+    shift_t aux = ina;
+    shift_t ina_uns = ina;
+    shift_t inb_uns = inb;
+    T out = 0;
+
+    switch (fns)
+    {
+    case ALU_OR:
+        out = inb | ina;
+        break;
+    case ALU_AND:
+        out = inb & ina;
+        break;
+    case ALU_XOR:
+        out = inb ^ ina;
+        break;
+    case ALU_SEXT8:
+        val = aux_a >> 7;
+        for (int i = W - 1; i > 7; i--)
+            aux_sext.set(i, val);
+        out = aux_sext.to_ulong() + aux_a;
+        break;
+    case ALU_SEXT16:
+        val = aux_a >> 15;
+        for (int i = W - 1; i > 15; i--)
+            aux_sext.set(i, val);
+        out = aux_sext.to_ulong() + aux_a;
+        break;
+    case ALU_SHIFTR_ARTH:
+        out = ina >> 1;
+        break;
+    case ALU_SHIFTR_LOG:
+        aux = aux >> 1;
+        out = (T)aux;
+        break;
+    case ALU_CMP_SIG:
+        aux_cmp.set(W - 1, ina > inb ? 1 : 0);
+        out = (T)aux_cmp.to_ulong();
+        break;
+    case ALU_CMP_UNS:
+        aux_cmp.set(W - 1, ina_uns > inb_uns ? 1 : 0);
+        out = (T)aux_cmp.to_ulong();
+        break;
+    case ALU_MUX:
+        out = ina < 0 ? inb : 0;
+        break;
+    case ALU_ADD:
+        out = ina + inb;
+        break;
+    case ALU_SUB:
+        out = inb - ina;
+        break;
+    case ALU_MAX:
+        out = ina > inb ? ina : inb;
+        break;
+    case ALU_MIN:
+        out = ina < inb ? ina : inb;
+        break;
+    default:
+        break;
+    }
+    return out;
+}
+
+//former CALULite::output()
+template <typename T>
+T bitset_alulite(int fns, T ina, T inb, T out)
+{
+    const int W = sizeof(T) * 8;
+    bitset<W + 1> ai;
+    bitset<W + 1> bz;
+    for (int i = 0; i < W + 1; i++)
+        ai.set(i, 0);
+    for (int i = 0; i < W + 1; i++)
+        bz.set(i, 1);
+    bitset<W> aux_cmp;
+    T loop = fns < 0 ? 1 : 0;
+    T op_a_int = loop ? out : ina;
+
+    switch (fns)
+    {
+    case ALULITE_OR:
+        out = op_a_int | inb;
+        break;
+    case ALULITE_AND:
+        out = op_a_int & inb;
+        break;
+    case ALULITE_CMP_SIG:
+        aux_cmp.set(W - 1, op_a_int > inb ? 1 : 0);
+        out = (T)aux_cmp.to_ulong();
+        break;
+    case ALULITE_MUX:
+        out = ina < 0 ? inb : loop == 1 ? out : 0;
+        break;
+    case ALULITE_SUB:
+        out = ina < 0 ? inb : op_a_int - inb;
+        break;
+    case ALULITE_ADD:
+        out = op_a_int + inb;
+        if (loop)
+            out = ina < 0 ? inb : out;
+        break;
+    case ALULITE_MAX:
+        out = ina < 0 ? out : max(op_a_int, inb);
+        break;
+    case ALULITE_MIN:
+        out = ina < 0 ? out : min(op_a_int, inb);
+        break;
+    default:
+        break;
+    }
+    return out;
+}
+
+//calls as made by output(): not inlined, function selected at run time
+template <typename T>
+__attribute__((noinline)) T call_bitset_alu(int fns, T a, T b) { return bitset_alu<T>(fns, a, b); }
+template <typename T>
+__attribute__((noinline)) T call_alu_op(int fns, T a, T b) { return alu_op<T>(fns, a, b); }
+template <typename T>
+__attribute__((noinline)) T call_bitset_alulite(int fns, T a, T b, T fb) { return bitset_alulite<T>(fns, a, b, fb); }
+template <typename T>
+__attribute__((noinline)) T call_alulite_op(int fns, T a, T b, T fb) { return alulite_op<T>(fns, a, b, fb); }
+
+//operands of the vectors on which f and g differ, f and g carry feedback
+template <typename T, typename F, typename G>
+int count_diff(F f, G g, vector<T> &a, vector<T> &b)
+{
+    int n = 0;
+    for (int i = 0; i < N_OPS; i++)
+        n += f(a[i], b[i]) != g(a[i], b[i]);
+    return n;
+}
+
+//ns per operation of f over the operand vectors, best of N_TRIALS
+template <typename T, typename F>
+double time_op(F f, vector<T> &a, vector<T> &b)
+{
+    volatile T sink = 0;
+    double best = 1e30;
+    for (int t = 0; t < N_TRIALS; t++)
+    {
+        T acc = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (int r = 0; r < N_REPS; r++)
+            for (int i = 0; i < N_OPS; i++)
+                acc += f(a[i], b[i]);
+        auto t1 = chrono::steady_clock::now();
+        sink = acc;
+        double ns = chrono::duration<double, nano>(t1 - t0).count() / ((double)N_REPS * N_OPS);
+        best = ns < best ? ns : best;
+    }
+    (void)sink;
+    return best;
+}
+
+template <typename T>
+void bench_width()
+{
+    const int W = sizeof(T) * 8;
+    const char *alu_name[16] = {"ADD", "SUB", "CMP_SIG", "MUX", "MAX", "MIN", "OR", "AND",
+                                "CMP_UNS", "XOR", "SEXT8", "SEXT16", "SHIFTR_ARTH", "SHIFTR_LOG", "CLZ", "ABS"};
+    //fns is only known at run time, as in the simulator
+    volatile int fns_base = 0;
+    vector<T> a(N_OPS), b(N_OPS);
+    for (int i = 0; i < N_OPS; i++)
+    {
+        a[i] = (T)rand();
+        b[i] = (T)rand();
+    }
+
+    for (int fns = fns_base; fns < 16; fns++)
+    {
+        auto f_old = [fns](T x, T y) { return call_bitset_alu<T>(fns, x, y); };
+        auto f_new = [fns](T x, T y) { return call_alu_op<T>(fns, x, y); };
+        int diff = count_diff<T>(f_old, f_new, a, b);
+        double t_old = time_op<T>(f_old, a, b);
+        double t_new = time_op<T>(f_new, a, b);
+        printf("DATAPATH_W=%-2d ALU_%-12s differ %4d/%d  bitset %6.2f ns  native %6.2f ns\n",
+               W, alu_name[fns], diff, N_OPS, t_old, t_new);
+    }
+    for (int fns = fns_base; fns < 8; fns++)
+    {
+        T fb_old = 0, fb_new = 0;
+        auto f_old = [fns, &fb_old](T x, T y) { return fb_old = call_bitset_alulite<T>(fns, x, y, fb_old); };
+        auto f_new = [fns, &fb_new](T x, T y) { return fb_new = call_alulite_op<T>(fns, x, y, fb_new); };
+        int diff = count_diff<T>(f_old, f_new, a, b);
+        double t_old = time_op<T>(f_old, a, b);
+        double t_new = time_op<T>(f_new, a, b);
+        printf("DATAPATH_W=%-2d ALULITE_%-8s differ %4d/%d  bitset %6.2f ns  native %6.2f ns\n",
+               W, alu_name[fns], diff, N_OPS, t_old, t_new);
+    }
+}
+
+int main()
+{
+    srand(1);
+    bench_width<int8_t>();
+    bench_width<int16_t>();
+    bench_width<int32_t>();
+    return 0;
+}
@@ -0,0 +1,542 @@
+//
+// Simulator benchmark
+// runs standard CGRA kernels on the topology of versat.h with every engine
+// and prints one JSON object per line:
+//   {"kernel", "params", "topology", "engine", "threads", "lanes",
+//    "cycles_per_run", "runs", "ns_per_cycle", "runs_per_s", "ok"}
+// ns_per_cycle is host time per simulated clock cycle of one data set,
+// ok is the check of the kernel output against a host reference
+// engine "batch" runs lanes data sets at once (batch.hpp): runs counts data
+// sets, so runs_per_s compares with the other engines as tiles per second
+//
+// usage: sim_bench.elf [-k kernel] [-e engine] [-t threads] [-b lanes] [-s seconds]
+//   -k  only kernels whose name contains kernel
+//   -e  only engine 0 (obj), 1 (soa), 2 (compiled) or 3 (batch), by number
+//       or name
+//   -t  also run the object engine with this many simulation threads
+//   -b  lanes of the batched runs (default 16)
+//   -s  minimum time measured per kernel and engine (default 0.2)
+//
+#include "versat.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PORT_READ 0
+#define PORT_WRITE 1
+
+static const char *engine_name[] = {"obj", "soa", "compiled", "batch"};
+#define ENGINE_BATCH 3
+
+//random inputs small enough for the products and sums of every kernel to
+//fit DATAPATH_W
+static void random_data(versat_t *data, int n)
+{
+    for (int i = 0; i < n; i++)
+        data[i] = rand() % 15 - 7;
+}
+
+//mem port p: iter periods of per steps, duty enabled, incr per step and
+//shift per period from start, after delay
+static void set_port(CMemPort &p, int in_wr, int sel, int start, int iter, int per, int duty, int incr, int shift, int delay)
+{
+    p.setInWr(in_wr);
+    p.setSel(sel);
+    p.setStart(start);
+    p.setIter(iter);
+    p.setPer(per);
+    p.setDuty(duty);
+    p.setIncr(incr);
+    p.setShift(shift);
+    p.setDelay(delay);
+}
+
+//outer loops of the 4 loop AGU: iter2 periods of per2 inner sequences
+static void set_port2(CMemPort &p, int iter2, int per2, int incr2, int shift2)
+{
+    p.setIter2(iter2);
+    p.setPer2(per2);
+    p.setIncr2(incr2);
+    p.setShift2(shift2);
+}
+
+//set the first ALULite (else ALU) of stage s to fns (ALULITE_ADD/MAX have
+//the codes of ALU_ADD/MAX), returns its databus selector and sets lat,
+//-1 if the topology has neither
+static int set_adder(VersatInstance &v, int s, int sel_a, int sel_b, int fns, int &lat)
+{
+#if nALULITE > 0
+    v.stage[s].alulite[0].setOpA(sel_a);
+    v.stage[s].alulite[0].setOpB(sel_b);
+    v.stage[s].alulite[0].setFNS(fns);
+    lat = ALULITE_LAT;
+    return v.sALULITE[0];
+#elif nALU > 0
+    v.stage[s].alu[0].setOpA(sel_a);
+    v.stage[s].alu[0].setOpB(sel_b);
+    v.stage[s].alu[0].setFNS(fns);
+    lat = ALU_LAT;
+    return v.sALU[0];
+#else
+    return -1;
+#endif
+}
+
+//
+// kernels
+// setup() configures the stages and loads the inputs, false if the topology
+// lacks the units the kernel needs; check() compares the outputs with the
+// host reference
+//
+class CBenchKernel
+{
+public:
+    virtual ~CBenchKernel() {}
+    virtual const char *name() = 0;
+    virtual string params() = 0;
+    virtual bool setup(VersatInstance &v) = 0;
+    virtual bool check(VersatInstance &v) = 0;
+};
+
+//c[i] = a[i] op b[i] on the adder, a in mem0, b in mem1, c after b
+class CVectorKernel : public CBenchKernel
+{
+    const char *kname;
+    int fns, n = MEM_SIZE / 2;
+    versat_t a[MEM_SIZE], b[MEM_SIZE];
+
+public:
+    CVectorKernel(const char *kname, int fns) : kname(kname), fns(fns) {}
+    const char *name() { return kname; }
+    string params() { return "n=" + to_string(n); }
+    bool setup(VersatInstance &v)
+    {
+        int lat, sel = nMEM < 2 ? -1 : set_adder(v, 0, v.sMEMA[0], v.sMEMA[1], fns, lat);
+        if (sel < 0)
+            return false;
+        random_data(a, n);
+        random_data(b, n);
+        v.stage[0].memA[0].write_block(0, a, n);
+        v.stage[0].memA[1].write_block(0, b, n);
+        set_port(v.stage[0].memA[0], PORT_READ, 0, 0, 1, n, n, 1, 0, 0);
+        set_port(v.stage[0].memA[1], PORT_READ, 0, 0, 1, n, n, 1, 0, 0);
+        set_port(v.stage[0].memB[1], PORT_WRITE, sel, n, 1, n, n, 1, 0, MEMP_LAT + lat);
+        return true;
+    }
+    bool check(VersatInstance &v)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            versat_t c = fns == ALULITE_ADD ? (versat_t)(a[i] + b[i]) : (a[i] > b[i] ? a[i] : b[i]);
+            if (v.stage[0].memA[1].read(n + i) != c)
+                return false;
+        }
+        return true;
+    }
+};
+
+#if nMULADD > 0
+//sum of a[i] * b[i] on the MulAdd
+class CDotKernel : public CBenchKernel
+{
+    int n = MEM_SIZE / 2;
+    versat_t a[MEM_SIZE], b[MEM_SIZE];
+
+public:
+    const char *name() { return "dot"; }
+    string params() { return "n=" + to_string(n); }
+    bool setup(VersatInstance &v)
+    {
+        if (nMEM < 2)
+            return false;
+        random_data(a, n);
+        random_data(b, n);
+        v.stage[0].memA[0].write_block(0, a, n);
+        v.stage[0].memA[1].write_block(0, b, n);
+        set_port(v.stage[0].memA[0], PORT_READ, 0, 0, 1, n, n, 1, 0, 0);
+        set_port(v.stage[0].memA[1], PORT_READ, 0, 0, 1, n, n, 1, 0, 0);
+        CMulAdd &ma = v.stage[0].muladd[0];
+        ma.setSelA(v.sMEMA[0]);
+        ma.setSelB(v.sMEMA[1]);
+        ma.setFNS(MULADD_MACC);
+        ma.setIter(1);
+        ma.setPer(n);
+        ma.setDelay(MEMP_LAT);
+        set_port(v.stage[0].memB[1], PORT_WRITE, v.sMULADD[0], n, 1, 1, 1, 1, 0, MEMP_LAT + n - 1 + MULADD_LAT);
+        return true;
+    }
+    bool check(VersatInstance &v)
+    {
+        long sum = 0;
+        for (int i = 0; i < n; i++)
+            sum += a[i] * b[i];
+        return v.stage[0].memA[1].read(n) == (versat_t)sum;
+    }
+};
+
+//y[i] = sum h[k] * x[i + k], one output per taps cycles
+class CFIRKernel : public CBenchKernel
+{
+    int taps = 4, n = MEM_SIZE / 2;
+    versat_t x[MEM_SIZE], h[MEM_SIZE];
+
+public:
+    const char *name() { return "fir"; }
+    string params() { return "taps=" + to_string(taps) + " n=" + to_string(n); }
+    bool setup(VersatInstance &v)
+    {
+        if (nMEM < 2 || n + taps - 1 > MEM_SIZE || taps > n)
+            return false;
+        random_data(x, n + taps - 1);
+        random_data(h, taps);
+        v.stage[0].memA[0].write_block(0, x, n + taps - 1);
+        v.stage[0].memA[1].write_block(0, h, taps);
+        set_port(v.stage[0].memA[0], PORT_READ, 0, 0, n, taps, taps, 1, -(taps - 1), 0);
+        set_port(v.stage[0].memA[1], PORT_READ, 0, 0, n, taps, taps, 1, -taps, 0);
+        CMulAdd &ma = v.stage[0].muladd[0];
+        ma.setSelA(v.sMEMA[0]);
+        ma.setSelB(v.sMEMA[1]);
+        ma.setFNS(MULADD_MACC);
+        ma.setIter(n);
+        ma.setPer(taps);
+        ma.setDelay(MEMP_LAT);
+        //store the last sum of every window
+        set_port(v.stage[0].memB[1], PORT_WRITE, v.sMULADD[0], n, n, taps, 1, 1, 0, MEMP_LAT + taps - 1 + MULADD_LAT);
+        return true;
+    }
+    bool check(VersatInstance &v)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            long y = 0;
+            for (int k = 0; k < taps; k++)
+                y += h[k] * x[i + k];
+            if (v.stage[0].memA[1].read(n + i) != (versat_t)y)
+                return false;
+        }
+        return true;
+    }
+};
+
+//C = A * B of d x d tiles, A and C in mem0, B in mem1
+class CGEMMKernel : public CBenchKernel
+{
+    int d;
+    versat_t a[MEM_SIZE], b[MEM_SIZE];
+
+public:
+    CGEMMKernel()
+    {
+        for (d = 1; (d + 1) * (d + 1) <= MEM_SIZE / 2; d++)
+            ;
+    }
+    const char *name() { return "gemm"; }
+    string params() { return "m=" + to_string(d) + " n=" + to_string(d) + " k=" + to_string(d); }
+    bool setup(VersatInstance &v)
+    {
+        if (nMEM < 2 || d < 2)
+            return false;
+        random_data(a, d * d);
+        random_data(b, d * d);
+        v.stage[0].memA[0].write_block(0, a, d * d);
+        v.stage[0].memA[1].write_block(0, b, d * d);
+        //A[i][k]: k inner, the row again for every j, next row for every i
+        set_port(v.stage[0].memA[0], PORT_READ, 0, 0, d, d, d, 1, -d, 0);
+        set_port2(v.stage[0].memA[0], 1, d, d, 0);
+        //B[k][j]: k inner down the column, next column for every j, again for every i
+        set_port(v.stage[0].memA[1], PORT_READ, 0, 0, d, d, d, d, -d * d + 1, 0);
+        set_port2(v.stage[0].memA[1], 1, d, 0, 0);
+        CMulAdd &ma = v.stage[0].muladd[0];
+        ma.setSelA(v.sMEMA[0]);
+        ma.setSelB(v.sMEMA[1]);
+        ma.setFNS(MULADD_MACC);
+        ma.setIter(d * d);
+        ma.setPer(d);
+        ma.setDelay(MEMP_LAT);
+        set_port(v.stage[0].memB[0], PORT_WRITE, v.sMULADD[0], MEM_SIZE / 2, d * d, d, 1, 1, 0, MEMP_LAT + d - 1 + MULADD_LAT);
+        return true;
+    }
+    bool check(VersatInstance &v)
+    {
+        for (int i = 0; i < d; i++)
+            for (int j = 0; j < d; j++)
+            {
+                long c = 0;
+                for (int k = 0; k < d; k++)
+                    c += a[i * d + k] * b[k * d + j];
+                if (v.stage[0].memA[0].read(MEM_SIZE / 2 + i * d + j) != (versat_t)c)
+                    return false;
+            }
+        return true;
+    }
+};
+
+//3x3 convolution of a w x w map, all outputs in one run
+//conv3d sums the 2D convolutions of every stage with the adders
+class CConvKernel : public CBenchKernel
+{
+    bool deep;
+    int w, o;
+    versat_t x[nSTAGE][MEM_SIZE], k[nSTAGE][9];
+
+public:
+    CConvKernel(bool deep) : deep(deep)
+    {
+        for (w = 3; (w + 1) * (w + 1) <= MEM_SIZE && (w - 1) * (w - 1) <= MEM_SIZE / 2; w++)
+            ;
+        o = w - 2;
+    }
+    const char *name() { return deep ? "conv3d" : "conv2d"; }
+    string params()
+    {
+        return "w=" + to_string(w) + " k=3" + (deep ? " c=" + to_string(nSTAGE) : "");
+    }
+    bool setup(VersatInstance &v)
+    {
+        int stages = deep ? nSTAGE : 1, lat = 0, delay = 0, sel = v.sMULADD[0];
+        if (nMEM < 2 || 9 > MEM_SIZE / 2 || (deep && (nSTAGE < 2 || set_adder(v, 0, 0, 0, ALULITE_ADD, lat) < 0)))
+            return false;
+        for (int s = 0; s < stages; s++)
+        {
+            random_data(x[s], w * w);
+            random_data(k[s], 9);
+            v.stage[s].memA[0].write_block(0, x[s], w * w);
+            v.stage[s].memA[1].write_block(0, k[s], 9);
+            //every stage after the second waits for the sum of the one before
+            if (s > 1)
+                delay += lat;
+            //3x3 window, next column, next row
+            set_port(v.stage[s].memA[0], PORT_READ, 0, 0, 3, 3, 3, 1, w - 3, delay);
+            set_port2(v.stage[s].memA[0], o, o, 1, w - o);
+            set_port(v.stage[s].memA[1], PORT_READ, 0, 0, o * o, 9, 9, 1, -9, delay);
+            CMulAdd &ma = v.stage[s].muladd[0];
+            ma.setSelA(v.sMEMA[0]);
+            ma.setSelB(v.sMEMA[1]);
+            ma.setFNS(MULADD_MACC);
+            ma.setIter(o * o);
+            ma.setPer(9);
+            ma.setDelay(MEMP_LAT + delay);
+            //previous stage sum (stage 0: its MulAdd) plus this MulAdd
+            if (s > 0)
+                sel = set_adder(v, s, sel + (1 << (N_W - 1)), v.sMULADD[0], ALULITE_ADD, lat);
+        }
+        set_port(v.stage[stages - 1].memB[1], PORT_WRITE, sel, MEM_SIZE / 2, o * o, 9, 1, 1, 0,
+                 MEMP_LAT + 8 + MULADD_LAT + (deep ? lat : 0) + delay);
+        return true;
+    }
+    bool check(VersatInstance &v)
+    {
+        int stages = deep ? nSTAGE : 1;
+        for (int i = 0; i < o; i++)
+            for (int j = 0; j < o; j++)
+            {
+                long y = 0;
+                for (int s = 0; s < stages; s++)
+                    for (int l = 0; l < 3; l++)
+                        for (int m = 0; m < 3; m++)
+                            y += x[s][(i + l) * w + j + m] * k[s][l * 3 + m];
+                if (v.stage[stages - 1].memA[1].read(MEM_SIZE / 2 + i * o + j) != (versat_t)y)
+                    return false;
+            }
+        return true;
+    }
+};
+#endif
+
+//y[i] = x[reverse(i)], read with the bit reversed addresses of xmem.v
+class CBitRevKernel : public CBenchKernel
+{
+    versat_t x[MEM_SIZE];
+
+public:
+    const char *name() { return "bitrev"; }
+    string params() { return "n=" + to_string(MEM_SIZE); }
+    bool setup(VersatInstance &v)
+    {
+        if (nMEM < 2)
+            return false;
+        random_data(x, MEM_SIZE);
+        v.stage[0].memA[0].write_block(0, x, MEM_SIZE);
+        set_port(v.stage[0].memA[0], PORT_READ, 0, 0, 1, MEM_SIZE, MEM_SIZE, 1, 0, 0);
+        v.stage[0].memA[0].setRvrs(1);
+        set_port(v.stage[0].memA[1], PORT_WRITE, v.sMEMA[0], 0, 1, MEM_SIZE, MEM_SIZE, 1, 0, MEMP_LAT);
+        return true;
+    }
+    bool check(VersatInstance &v)
+    {
+        for (int i = 0; i < MEM_SIZE; i++)
+        {
+            int r = 0;
+            for (int b = 0; b < MEM_ADDR_W; b++)
+                r |= ((i >> b) & 1) << (MEM_ADDR_W - 1 - b);
+            if (v.stage[0].memA[1].read(i) != x[r])
+                return false;
+        }
+        return true;
+    }
+};
+
+static string topology()
+{
+    char t[256];
+    snprintf(t, sizeof(t), "nSTAGE=%d nMEM=%d MEM_ADDR_W=%d DATAPATH_W=%d nALU=%d nALULITE=%d nMUL=%d nMULADD=%d nBS=%d",
+             nSTAGE, nMEM, MEM_ADDR_W, DATAPATH_W, nALU, nALULITE, nMUL, nMULADD, nBS);
+    return t;
+}
+
+static void print_result(CBenchKernel &kern, int engine, int threads, int lanes, int cycles, long runs, double secs,
+                         bool ok)
+{
+    printf("{\"kernel\": \"%s\", \"params\": \"%s\", \"topology\": \"%s\", \"engine\": \"%s\", \"threads\": %d, "
+           "\"lanes\": %d, \"cycles_per_run\": %d, \"runs\": %ld, \"ns_per_cycle\": %.2f, \"runs_per_s\": %.1f, "
+           "\"ok\": %s}\n",
+           kern.name(), kern.params().c_str(), topology().c_str(), engine_name[engine], threads, lanes,
+           cycles, runs, secs * 1e9 / ((double)runs * cycles), runs / secs, ok ? "true" : "false");
+    fflush(stdout);
+}
+
+//measure kernel kern on engine with threads, at least min_time seconds
+static void bench(VersatInstance &v, CBenchKernel &kern, int engine, int threads, double min_time)
+{
+    typedef std::chrono::steady_clock clk;
+    v.set_engine(engine);
+    v.set_sim_threads(threads);
+    v.globalClearConf();
+    srand(1);
+    if (!kern.setup(v))
+        return;
+
+    //first run: cycles and output check
+    v.run();
+    v.wait();
+    int cycles = v.versat_iter;
+    bool ok = kern.check(v);
+
+    //batches of runs, doubled until they take min_time
+    long runs = 0;
+    double secs = 0;
+    for (long batch = 1; secs < min_time; batch *= 2)
+    {
+        clk::time_point t0 = clk::now();
+        for (long r = 0; r < batch; r++)
+            v.run();
+        v.wait();
+        secs += std::chrono::duration<double>(clk::now() - t0).count();
+        runs += batch;
+    }
+    print_result(kern, engine, threads, 1, cycles, runs, secs, ok);
+}
+
+//measure kernel kern on lanes copies of its inputs, at least min_time seconds
+static void bench_batch(VersatInstance &v, CBenchKernel &kern, int lanes, double min_time)
+{
+    typedef std::chrono::steady_clock clk;
+    v.set_engine(VERSAT_ENGINE_OBJ);
+    v.set_sim_threads(1);
+    v.globalClearConf();
+    srand(1);
+    if (!kern.setup(v))
+        return;
+    CBatchRun batch(&v, lanes);
+    for (int l = 0; l < lanes; l++)
+        batch.load(l);
+
+    //first run: cycles and output check of every lane
+    int cycles = v.run_batch(batch);
+    if (cycles < 0)
+        return;
+    bool ok = true;
+    for (int l = 0; l < lanes; l++)
+    {
+        batch.store(l);
+        ok = ok && kern.check(v);
+    }
+
+    long runs = 0;
+    double secs = 0;
+    for (long n = 1; secs < min_time; n *= 2)
+    {
+        clk::time_point t0 = clk::now();
+        for (long r = 0; r < n; r++)
+            v.run_batch(batch);
+        secs += std::chrono::duration<double>(clk::now() - t0).count();
+        runs += n * lanes;
+    }
+    print_result(kern, ENGINE_BATCH, 1, lanes, cycles, runs, secs, ok);
+}
+
+//engine of -e: its number or its name in engine_name[], -1 if neither
+static int parse_engine(const char *arg)
+{
+    for (int e = 0; e <= ENGINE_BATCH; e++)
+        if (!strcmp(arg, engine_name[e]) || (arg[0] == '0' + e && arg[1] == 0))
+            return e;
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = "";
+    int only_engine = -1, threads = 1, lanes = 16, opt, usage = 0;
+    double min_time = 0.2;
+    while ((opt = getopt(argc, argv, "k:e:t:b:s:")) != -1)
+    {
+        if (opt == 'k')
+            filter = optarg;
+        else if (opt == 'e')
+        {
+            only_engine = parse_engine(optarg);
+            if (only_engine < 0)
+            {
+                printf("Invalid engine %s\n", optarg);
+                usage = 1;
+            }
+        }
+        else if (opt == 't')
+            threads = atoi(optarg);
+        else if (opt == 'b')
+            lanes = atoi(optarg);
+        else if (opt == 's')
+            min_time = atof(optarg);
+        else
+            usage = 1;
+    }
+    if (usage)
+    {
+        printf("usage: %s [-k kernel] [-e engine] [-t threads] [-b lanes] [-s seconds]\n", argv[0]);
+        return 1;
+    }
+
+    CVectorKernel vadd("vadd", ALULITE_ADD), vmax("vmax", ALULITE_MAX);
+    CBitRevKernel bitrev;
+    std::vector<CBenchKernel *> kernels = {&vadd, &vmax, &bitrev};
+#if nMULADD > 0
+    CDotKernel dot;
+    CFIRKernel fir;
+    CGEMMKernel gemm;
+    CConvKernel conv2d(false), conv3d(true);
+    kernels.insert(kernels.end(), {&dot, &fir, &gemm, &conv2d, &conv3d});
+#endif
+
+    VersatInstance *v = new VersatInstance;
+    int fails = 0;
+    for (CBenchKernel *k : kernels)
+    {
+        if (!strstr(k->name(), filter))
+            continue;
+        for (int e = 0; e < 3; e++)
+            if (only_engine < 0 || only_engine == e)
+                bench(*v, *k, e, 1, min_time);
+        if (threads > 1 && only_engine <= 0)
+            bench(*v, *k, VERSAT_ENGINE_OBJ, threads, min_time);
+        if (lanes > 0 && (only_engine < 0 || only_engine == ENGINE_BATCH))
+            bench_batch(*v, *k, lanes, min_time);
+        v->globalClearConf();
+        srand(1);
+        fails += k->setup(*v) && (v->run(), v->wait(), !k->check(*v));
+    }
+    delete v;
+    return fails != 0;
+}
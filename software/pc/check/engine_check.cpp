@@ -0,0 +1,301 @@
+//
+// Engine differential check
+// Random configurations and memory contents, from a seed, are run by the
+// object engine with one thread, the reference, and by:
+//   - the object engine with ENGINE_CHECK_THREADS threads
+//   - the SoA and the compiled engines
+//   - batched runs (batch.hpp) of ENGINE_CHECK_LANES data sets, each lane
+//     against a scalar run of its data set
+//   - runs paused half way, checkpointed and restored in a new instance
+// After every run the cycle count and all the memories must match the
+// reference.
+//
+// usage: engine_check.elf [-s seeds] [-r runs]
+//   -s  seeds checked (default 20)
+//   -r  runs per seed (default 3), each one reconfigures all the FUs
+//
+#include "versat.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ENGINE_CHECK_THREADS 3
+#define ENGINE_CHECK_LANES 3
+
+static int R(int n) { return rand() % n; }
+
+//
+// random configuration
+//
+#if nMEM > 0
+//addresses of the 4 loop AGU with non negative increments are bounded by
+//start + iter * (per * incr + shift) + iter2 * (per2 * incr2 + shift2)
+//a third of the ports run 4 loops
+static void random_port(CMemPort &p, int n_sel, int mem_size)
+{
+    int bound;
+    do
+    {
+        int per = 1 + R(4);
+        p.setPer(per);
+        p.setIter(1 + R(3));
+        p.setDuty(R(3) ? per : R(per + 1));
+        p.setIncr(R(2));
+        p.setShift(R(3));
+        p.setStart(R(mem_size / 4));
+        bool four = R(3) == 0;
+        p.setIter2(four ? 1 + R(2) : 0);
+        p.setPer2(four ? 1 + R(2) : 0);
+        p.setIncr2(four ? R(3) : 0);
+        p.setShift2(four ? R(3) : 0);
+        bound = p.start + p.iter * (p.per * p.incr + p.shift) + p.iter2 * (p.per2 * p.incr2 + p.shift2);
+    } while (bound >= mem_size);
+    p.setDelay(R(6));
+    p.setSel(R(n_sel));
+    p.setInWr(R(3) == 0);
+    p.setRvrs(0);
+    p.setExt(0);
+}
+#endif
+
+//configure all the FUs of all stages of v
+static void random_conf(VersatInstance &v)
+{
+    int n_sel = 2 * (1 << (N_W - 1));
+    for (int s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = v.stage[s];
+        int i;
+#if nMEM > 0
+        for (i = 0; i < nMEM; i++)
+        {
+            random_port(st.memA[i], n_sel, v.mem_size());
+            random_port(st.memB[i], n_sel, v.mem_size());
+        }
+#endif
+#if nALU > 0
+        for (i = 0; i < nALU; i++)
+        {
+            st.alu[i].setOpA(R(n_sel));
+            st.alu[i].setOpB(R(n_sel));
+            st.alu[i].setFNS(R(16));
+        }
+#endif
+#if nALULITE > 0
+        for (i = 0; i < nALULITE; i++)
+        {
+            st.alulite[i].setOpA(R(n_sel));
+            st.alulite[i].setOpB(R(n_sel));
+            st.alulite[i].setFNS(R(16));
+        }
+#endif
+#if nMUL > 0
+        for (i = 0; i < nMUL; i++)
+        {
+            st.mul[i].setSelA(R(n_sel));
+            st.mul[i].setSelB(R(n_sel));
+            st.mul[i].setFNS(R(4));
+        }
+#endif
+#if nMULADD > 0
+        for (i = 0; i < nMULADD; i++)
+        {
+            CMulAdd &u = st.muladd[i];
+            u.setSelA(R(n_sel));
+            u.setSelB(R(n_sel));
+            u.setFNS(R(2));
+            u.setIter(1 + R(3));
+            u.setPer(1 + R(5));
+            u.setDelay(R(5));
+            u.setShift(R(3));
+        }
+#endif
+#if nBS > 0
+        for (i = 0; i < nBS; i++)
+        {
+            st.bs[i].setData(R(n_sel));
+            st.bs[i].setShift(R(n_sel));
+            st.bs[i].setFNS(R(3));
+        }
+#endif
+    }
+}
+
+//random contents of all the memories of v
+static void random_mem(VersatInstance &v)
+{
+    for (int s = 0; s < nSTAGE; s++)
+        for (int m = 0; m < nMEM; m++)
+            for (int a = 0; a < v.mem_size(); a++)
+            {
+                versat_t d = (versat_t)(R(200) - 100);
+                v.versat_mem[s][m].write_block(a, &d, 1, v.mem_size());
+            }
+}
+
+//
+// comparison with the reference
+//
+static int fails = 0;
+
+//first word of the memories of v that differs from ref, -1 if none
+static int mem_diff(VersatInstance &ref, VersatInstance &v)
+{
+    for (int s = 0; s < nSTAGE; s++)
+        for (int m = 0; m < nMEM; m++)
+            for (int a = 0; a < ref.mem_size(); a++)
+                if (ref.versat_mem[s][m].ptr()[a] != v.versat_mem[s][m].ptr()[a])
+                    return (s * nMEM + m) * ref.mem_size() + a;
+    return -1;
+}
+
+static void check(const char *what, int seed, int r, int ref_cycles, int cycles, int diff, int mem_size)
+{
+    if (cycles != ref_cycles)
+        printf("Seed %d run %d: %s takes %d cycles, the reference %d\n", seed, r, what, cycles, ref_cycles);
+    else if (diff >= 0)
+        printf("Seed %d run %d: %s differs at stage %d mem%d[%d]\n", seed, r, what, diff / (nMEM * mem_size),
+               diff / mem_size % nMEM, diff % mem_size);
+    else
+        return;
+    fails++;
+}
+
+int main(int argc, char **argv)
+{
+    int seeds = 20, runs = 3, opt;
+    while ((opt = getopt(argc, argv, "s:r:")) != -1)
+    {
+        if (opt == 's')
+            seeds = atoi(optarg);
+        else if (opt == 'r')
+            runs = atoi(optarg);
+        else
+            optind = argc + 1;
+    }
+    if (optind != argc)
+    {
+        printf("usage: %s [-s seeds] [-r runs]\n", argv[0]);
+        return 1;
+    }
+
+    //reference and the engines compared with it
+    struct
+    {
+        const char *name;
+        int engine, threads;
+    } variant[] = {{"object engine, 1 thread", VERSAT_ENGINE_OBJ, 1},
+                   {"object engine, 3 threads", VERSAT_ENGINE_OBJ, ENGINE_CHECK_THREADS},
+                   {"SoA engine", VERSAT_ENGINE_SOA, 1},
+                   {"compiled engine", VERSAT_ENGINE_COMPILED, 1}};
+    const int n_var = sizeof(variant) / sizeof(variant[0]);
+    bool batched = nVI == 0 && nVO == 0;
+    if (!batched)
+        printf("VI/VO are not batched, batched runs are not checked\n");
+
+    std::vector<CStageConf> conf(nSTAGE);
+    for (int seed = 1; seed <= seeds; seed++)
+    {
+        VersatInstance *v[n_var];
+        for (int k = 0; k < n_var; k++)
+        {
+            v[k] = new VersatInstance;
+            v[k]->set_engine(variant[k].engine);
+            v[k]->set_sim_threads(variant[k].threads);
+        }
+        VersatInstance &ref = *v[0];
+        //mid-run checkpoints: paused instance, the reference state before each run
+        VersatInstance *cp = new VersatInstance;
+        //batched runs and a scalar instance per lane
+        VersatInstance *bv = new VersatInstance;
+        VersatInstance *lane[ENGINE_CHECK_LANES];
+        CBatchRun batch(bv, ENGINE_CHECK_LANES);
+
+        srand(seed);
+        random_mem(ref);
+        for (int k = 1; k < n_var; k++)
+            memcpy((void *)v[k]->versat_mem, ref.versat_mem, sizeof(ref.versat_mem));
+        memcpy((void *)cp->versat_mem, ref.versat_mem, sizeof(ref.versat_mem));
+        for (int l = 0; l < ENGINE_CHECK_LANES; l++)
+        {
+            lane[l] = new VersatInstance;
+            random_mem(*lane[l]);
+            memcpy((void *)bv->versat_mem, lane[l]->versat_mem, sizeof(bv->versat_mem));
+            batch.load(l);
+        }
+
+        for (int r = 0; r < runs; r++)
+        {
+            random_conf(ref);
+            ref.get_conf(conf.data());
+            for (int k = 1; k < n_var; k++)
+                v[k]->set_conf(conf.data());
+            cp->set_conf(conf.data());
+            bv->set_conf(conf.data());
+            for (int l = 0; l < ENGINE_CHECK_LANES; l++)
+                lane[l]->set_conf(conf.data());
+
+            //engines
+            for (int k = 0; k < n_var; k++)
+            {
+                v[k]->run();
+                v[k]->wait();
+            }
+            for (int k = 1; k < n_var; k++)
+                check(variant[k].name, seed, r, ref.versat_iter, v[k]->versat_iter, mem_diff(ref, *v[k]),
+                      ref.mem_size());
+
+            //checkpoint half way, finish in a new instance and in cp
+            int half = ref.versat_iter / 2;
+            cp->set_run_break(half);
+            cp->run();
+            cp->wait();
+            if (half > 0 && cp->paused())
+            {
+                VersatInstance *rv = new VersatInstance;
+                if (rv->restore(cp->checkpoint()))
+                {
+                    printf("Seed %d run %d: the checkpoint does not restore\n", seed, r);
+                    fails++;
+                }
+                else
+                {
+                    rv->resume();
+                    rv->wait();
+                    check("restored checkpoint", seed, r, ref.versat_iter, rv->versat_iter, mem_diff(ref, *rv),
+                          ref.mem_size());
+                }
+                delete rv;
+                cp->resume();
+                cp->wait();
+            }
+            check("paused run", seed, r, ref.versat_iter, cp->versat_iter, mem_diff(ref, *cp), ref.mem_size());
+            cp->set_run_break(0);
+
+            //batch, lane by lane against the scalar runs
+            if (!batched)
+                continue;
+            int cycles = bv->run_batch(batch);
+            for (int l = 0; l < ENGINE_CHECK_LANES; l++)
+            {
+                lane[l]->run();
+                lane[l]->wait();
+                batch.store(l);
+                char name[32];
+                snprintf(name, sizeof(name), "batch lane %d", l);
+                check(name, seed, r, lane[l]->versat_iter, cycles, mem_diff(*lane[l], *bv), ref.mem_size());
+            }
+        }
+
+        for (int k = 0; k < n_var; k++)
+            delete v[k];
+        for (int l = 0; l < ENGINE_CHECK_LANES; l++)
+            delete lane[l];
+        delete cp;
+        delete bv;
+    }
+    if (fails == 0)
+        printf("%d seeds of %d runs: engines, batches and checkpoints match\n", seeds, runs);
+    return fails != 0;
+}
@@ -0,0 +1,428 @@
+//
+// Co-simulation against the RTL
+// Random configurations and memory contents, from a seed, are simulated by
+// the C++ model and by hardware/testbench/xversat_cosim_tb.v (Icarus), and
+// the stage databus slots are compared cycle by cycle and the memories at
+// the end of every run.
+// UNTESTED: this harness has not been run against the RTL yet. The offset,
+// the rtl_bus.hex layout and the rtl_mem.hex parsing were only checked on
+// dumps made from the C++ traces, so the first make cosim may report
+// mismatches of the harness itself.
+// BS units only pass their data through (no shift function): CBS::shift
+// is the shift amount, while xbs.v shifts by the value of the databus slot
+// BS_CONF_SELS selects, so the BS shift is not co-simulated.
+//
+// usage: cosim.elf [-r runs] [-e engine] [-t threads] [-o offset] gen|check <dir> <seed>
+//   gen    writes <dir>/stim.hex, the CPU writes of the memory contents and
+//          of the configurations of each run, for the RTL testbench
+//   check  compares <dir>/rtl_bus.hex and <dir>/rtl_mem.hex, dumped by the
+//          testbench, with the C++ model
+//   -r  runs per seed (default 2), each one reconfigures all the FUs
+//   -e  engine simulated (default 0, object)
+//   -t  simulation threads of the object engine
+//   -o  RTL cycle of C++ cycle 0 (default COSIM_OFFSET), the same for all runs
+// Every databus slot of every stage is compared, the traced C++ runs
+// simulate all the FUs.
+// <dir>/cpp_run<r>.trace is the C++ cycle trace of run r, python/trace2vcd.py
+// converts it to VCD to view next to xversat.vcd of the testbench.
+//
+#include "versat.hpp"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//RTL cycle of C++ cycle 0, derived from the RTL sources and not yet
+//observed in a simulation: line 0 of a run is the clock edge of the run
+//write (xdata_eng.v ctr_reg), the AGUs start on the next one and the
+//memory data reaches the databus MEMP_LAT edges later, on line 4, where
+//the C++ trace has it at cycle MEMP_LAT - 1
+#define COSIM_OFFSET 2
+//C++ runs are a few hundred cycles, a longer one does not end
+#define COSIM_TIMEOUT_US 10000000
+
+//address map of xversat.v / xstage.v / xdata_eng.v
+#define COSIM_STAGE(s) ((uint32_t)(s) << (BASE_ADDR_W + 2))
+#define COSIM_CONF_BASE (1u << (BASE_ADDR_W + 1))
+//stim.hex marker entries, addr COSIM_MARK: data 1 runs, 0 ends
+#define COSIM_MARK 0xFFFFFFFFu
+
+#define DATAPATH_MASK (DATAPATH_W >= 32 ? 0xFFFFFFFFu : (1u << DATAPATH_W) - 1)
+
+static int R(int n) { return rand() % n; }
+
+//cpu writes of the testbench
+static std::vector<std::pair<uint32_t, uint32_t>> stim;
+
+static void conf_write(int s, int field, int val)
+{
+    stim.push_back({COSIM_STAGE(s) + COSIM_CONF_BASE + field, (uint32_t)val});
+}
+
+//
+// random configuration
+//
+//databus selectors of the stage and of the previous one
+static std::vector<int> selectors()
+{
+    std::vector<int> sel;
+    for (int k = 0; k < N; k++)
+    {
+        sel.push_back(k);
+        sel.push_back(k + (1 << (N_W - 1)));
+    }
+    return sel;
+}
+
+#if nMEM > 0
+//addresses of the 4 loop AGU with non negative increments are bounded by
+//start + iter * (per * incr + shift) + iter2 * (per2 * incr2 + shift2)
+//a third of the ports run 4 loops
+static void random_port(CMemPort &p, const std::vector<int> &sel)
+{
+    int bound;
+    do
+    {
+        int per = 1 + R(4);
+        p.setPer(per);
+        p.setIter(1 + R(3));
+        p.setDuty(R(3) ? per : R(per + 1));
+        p.setIncr(R(2));
+        p.setShift(R(3));
+        p.setStart(R(MEM_SIZE / 4));
+        bool four = R(3) == 0;
+        p.setIter2(four ? 1 + R(2) : 0);
+        p.setPer2(four ? 1 + R(2) : 0);
+        p.setIncr2(four ? R(3) : 0);
+        p.setShift2(four ? R(3) : 0);
+        bound = p.start + p.iter * (p.per * p.incr + p.shift) + p.iter2 * (p.per2 * p.incr2 + p.shift2);
+    } while (bound >= MEM_SIZE);
+    p.setDelay(R(6));
+    p.setSel(sel[R(sel.size())]);
+    p.setInWr(R(3) == 0);
+    p.setRvrs(R(8) == 0);
+    p.setExt(0);
+}
+
+static void conf_port(int s, int j, CMemPort &p)
+{
+    int base = CONF_MEM0A + j * MEMP_CONF_OFFSET;
+    conf_write(s, base + MEMP_CONF_ITER, p.iter);
+    conf_write(s, base + MEMP_CONF_PER, p.per);
+    conf_write(s, base + MEMP_CONF_DUTY, p.duty);
+    conf_write(s, base + MEMP_CONF_SEL, p.sel);
+    conf_write(s, base + MEMP_CONF_START, p.start);
+    conf_write(s, base + MEMP_CONF_SHIFT, p.shift);
+    conf_write(s, base + MEMP_CONF_INCR, p.incr);
+    conf_write(s, base + MEMP_CONF_DELAY, p.delay);
+    conf_write(s, base + MEMP_CONF_RVRS, p.rvrs);
+    conf_write(s, base + MEMP_CONF_EXT, p.ext);
+    conf_write(s, base + MEMP_CONF_IN_WR, p.in_wr);
+    conf_write(s, base + MEMP_CONF_ITER2, p.iter2);
+    conf_write(s, base + MEMP_CONF_PER2, p.per2);
+    conf_write(s, base + MEMP_CONF_SHIFT2, p.shift2);
+    conf_write(s, base + MEMP_CONF_INCR2, p.incr2);
+}
+#endif
+
+//configure all the FUs of all stages, in the model and in stim
+static void random_conf(VersatInstance &v)
+{
+    std::vector<int> sel = selectors();
+    for (int s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = v.stage[s];
+        int i;
+#if nMEM > 0
+        for (i = 0; i < nMEM; i++)
+        {
+            random_port(st.memA[i], sel);
+            random_port(st.memB[i], sel);
+            conf_port(s, 2 * i, st.memA[i]);
+            conf_port(s, 2 * i + 1, st.memB[i]);
+        }
+#endif
+#if nALU > 0
+        for (i = 0; i < nALU; i++)
+        {
+            st.alu[i].setOpA(sel[R(sel.size())]);
+            st.alu[i].setOpB(sel[R(sel.size())]);
+            st.alu[i].setFNS(R(16));
+            conf_write(s, CONF_ALU0 + i * ALU_CONF_OFFSET + ALU_CONF_SELA, st.alu[i].opa);
+            conf_write(s, CONF_ALU0 + i * ALU_CONF_OFFSET + ALU_CONF_SELB, st.alu[i].opb);
+            conf_write(s, CONF_ALU0 + i * ALU_CONF_OFFSET + ALU_CONF_FNS, st.alu[i].fns);
+        }
+#endif
+#if nALULITE > 0
+        for (i = 0; i < nALULITE; i++)
+        {
+            st.alulite[i].setOpA(sel[R(sel.size())]);
+            st.alulite[i].setOpB(sel[R(sel.size())]);
+            st.alulite[i].setFNS(R(16));
+            conf_write(s, CONF_ALULITE0 + i * ALULITE_CONF_OFFSET + ALULITE_CONF_SELA, st.alulite[i].opa);
+            conf_write(s, CONF_ALULITE0 + i * ALULITE_CONF_OFFSET + ALULITE_CONF_SELB, st.alulite[i].opb);
+            conf_write(s, CONF_ALULITE0 + i * ALULITE_CONF_OFFSET + ALULITE_CONF_FNS, st.alulite[i].fns);
+        }
+#endif
+#if nMUL > 0
+        for (i = 0; i < nMUL; i++)
+        {
+            st.mul[i].setSelA(sel[R(sel.size())]);
+            st.mul[i].setSelB(sel[R(sel.size())]);
+            st.mul[i].setFNS(R(4));
+            conf_write(s, CONF_MUL0 + i * MUL_CONF_OFFSET + MUL_CONF_SELA, st.mul[i].sela);
+            conf_write(s, CONF_MUL0 + i * MUL_CONF_OFFSET + MUL_CONF_SELB, st.mul[i].selb);
+            conf_write(s, CONF_MUL0 + i * MUL_CONF_OFFSET + MUL_CONF_FNS, st.mul[i].fns);
+        }
+#endif
+#if nMULADD > 0
+        for (i = 0; i < nMULADD; i++)
+        {
+            CMulAdd &u = st.muladd[i];
+            int base = CONF_MULADD0 + i * MULADD_CONF_OFFSET;
+            u.setSelA(sel[R(sel.size())]);
+            u.setSelB(sel[R(sel.size())]);
+            u.setFNS(R(2));
+            u.setIter(1 + R(3));
+            u.setPer(1 + R(5));
+            u.setDelay(R(5));
+            u.setShift(R(3));
+            conf_write(s, base + MULADD_CONF_SELA, u.sela);
+            conf_write(s, base + MULADD_CONF_SELB, u.selb);
+            conf_write(s, base + MULADD_CONF_FNS, u.fns);
+            conf_write(s, base + MULADD_CONF_ITER, u.iter);
+            conf_write(s, base + MULADD_CONF_PER, u.per);
+            conf_write(s, base + MULADD_CONF_DELAY, u.delay);
+            conf_write(s, base + MULADD_CONF_SHIFT, u.shift);
+        }
+#endif
+#if nBS > 0
+        for (i = 0; i < nBS; i++)
+        {
+            //pass through: the shift selector is not modelled (see above)
+            st.bs[i].setData(sel[R(sel.size())]);
+            st.bs[i].setShift(0);
+            st.bs[i].setFNS(BS_SHL + 1);
+            conf_write(s, CONF_BS0 + i * BS_CONF_OFFSET + BS_CONF_SELD, st.bs[i].data);
+            conf_write(s, CONF_BS0 + i * BS_CONF_OFFSET + BS_CONF_SELS, st.bs[i].shift);
+            conf_write(s, CONF_BS0 + i * BS_CONF_OFFSET + BS_CONF_FNS, st.bs[i].fns);
+        }
+#endif
+    }
+}
+
+//
+// RTL dumps
+//
+//lines of each run of a testbench dump, runs start at "# run" lines
+static int read_dump(const string &path, std::vector<std::vector<string>> &runs)
+{
+    ifstream f(path);
+    if (!f)
+    {
+        printf("Cannot open %s\n", path.c_str());
+        return -1;
+    }
+    string line;
+    while (getline(f, line))
+    {
+        if (line.compare(0, 1, "#") == 0)
+            runs.emplace_back();
+        else if (runs.size() && line.size())
+            runs.back().push_back(line);
+    }
+    return 0;
+}
+
+//DATAPATH_W bits from bit lsb of a hex line, x/z read as 1
+static uint32_t hex_field(const string &hex, int lsb)
+{
+    uint32_t v = 0;
+    for (int b = 0; b < DATAPATH_W; b++)
+    {
+        int d = (lsb + b) / 4, n = hex.size();
+        if (d >= n)
+            break;
+        char c = hex[n - 1 - d];
+        int x = isdigit(c) ? c - '0' : isxdigit(c) ? tolower(c) - 'a' + 10 : 0xF;
+        v |= (uint32_t)((x >> ((lsb + b) % 4)) & 1) << b;
+    }
+    return v;
+}
+
+//slot (s, sel) of a line of rtl_bus.hex: the databus of stage 0 first, each
+//stage in databus order, {MEM0A, MEM0B, ..., BS<nBS-1>}
+static uint32_t bus_slot(const string &line, int s, int sel)
+{
+    return hex_field(line, (nSTAGE * N - 1 - (s * N + sel)) * DATAPATH_W);
+}
+
+//C++ values of the databus slots of a run, cycle by cycle
+struct CCosimRun
+{
+    int cycles;
+    std::vector<CTraceSignal> sig;
+    std::vector<std::vector<uint32_t>> value;
+};
+
+//mismatches of run with the RTL lines from RTL cycle offset, the first one
+//described in first
+static int compare_bus(const CCosimRun &run, const std::vector<string> &rtl, int offset, string &first)
+{
+    if ((int)rtl.size() < offset + run.cycles)
+    {
+        first = "RTL run of " + to_string(rtl.size()) + " cycles ends before the C++ one";
+        return 1;
+    }
+    int n = 0;
+    for (int c = 0; c < run.cycles; c++)
+        for (size_t k = 0; k < run.sig.size(); k++)
+        {
+            uint32_t r = bus_slot(rtl[offset + c], run.sig[k].stage, run.sig[k].sel);
+            if (r == run.value[c][k])
+                continue;
+            if (n++ == 0)
+            {
+                char m[160];
+                snprintf(m, sizeof(m), "cycle %d stage %d %s: C++ %x, RTL %x", c, run.sig[k].stage, run.sig[k].name,
+                         run.value[c][k], r);
+                first = m;
+            }
+        }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 2, engine = VERSAT_ENGINE_OBJ, threads = 1, offset = COSIM_OFFSET, opt;
+    while ((opt = getopt(argc, argv, "r:e:t:o:")) != -1)
+    {
+        if (opt == 'r')
+            runs = atoi(optarg);
+        else if (opt == 'e')
+            engine = atoi(optarg);
+        else if (opt == 't')
+            threads = atoi(optarg);
+        else if (opt == 'o')
+            offset = atoi(optarg);
+        else
+            optind = argc + 1;
+    }
+    if (optind + 3 != argc || (strcmp(argv[optind], "gen") && strcmp(argv[optind], "check")))
+    {
+        printf("usage: %s [-r runs] [-e engine] [-t threads] [-o offset] gen|check <dir> <seed>\n", argv[0]);
+        return 1;
+    }
+#if nVI > 0 || nVO > 0
+    printf("Co-simulation does not model the external memory of the VI/VO\n");
+    return 1;
+#endif
+    bool gen = strcmp(argv[optind], "gen") == 0;
+    string dir = argv[optind + 1];
+    int seed = atoi(argv[optind + 2]);
+
+    VersatInstance *v = new VersatInstance;
+    v->set_engine(engine);
+    v->set_sim_threads(threads);
+    srand(seed);
+
+    //memory contents, full width
+    for (int s = 0; s < nSTAGE; s++)
+        for (int m = 0; m < nMEM; m++)
+            for (int a = 0; a < MEM_SIZE; a++)
+            {
+                versat_t d = (versat_t)(rand() ^ (rand() << 15));
+                v->versat_mem[s][m].write_block(a, &d, 1, v->mem_size());
+                stim.push_back({COSIM_STAGE(s) + (m << MEM_ADDR_W) + a, (uint32_t)(int32_t)d});
+            }
+
+    std::vector<CCosimRun> cpp(runs);
+    std::vector<std::vector<versat_t>> cpp_mem(runs);
+    for (int r = 0; r < runs; r++)
+    {
+        random_conf(*v);
+        stim.push_back({COSIM_MARK, 1});
+
+        string trace = dir + "/cpp_run" + to_string(r) + ".trace";
+        if (v->trace_open(trace.c_str()))
+            return 1;
+        v->run();
+        if (!v->wait_for(COSIM_TIMEOUT_US))
+        {
+            printf("Seed %d run %d: C++ run not done after %d us\n", seed, r, COSIM_TIMEOUT_US);
+            exit(1);
+        }
+        v->trace_close();
+
+        //slots of the trace, their values at every cycle
+        CCosimRun &run = cpp[r];
+        CTraceReader tr;
+        if (tr.open(trace.c_str()))
+            return 1;
+        run.sig = tr.signals;
+        run.cycles = v->versat_iter;
+        for (int c = 0; c < run.cycles; c++)
+        {
+            const std::vector<versat_t> &val = tr.at(c);
+            run.value.emplace_back();
+            for (versat_t d : val)
+                run.value.back().push_back((uint32_t)d & DATAPATH_MASK);
+        }
+        for (int s = 0; s < nSTAGE; s++)
+            for (int m = 0; m < nMEM; m++)
+                cpp_mem[r].insert(cpp_mem[r].end(), v->versat_mem[s][m].ptr(), v->versat_mem[s][m].ptr() + MEM_SIZE);
+    }
+    stim.push_back({COSIM_MARK, 0});
+    delete v;
+
+    if (gen)
+    {
+        string path = dir + "/stim.hex";
+        FILE *f = fopen(path.c_str(), "w");
+        if (!f)
+        {
+            printf("Cannot open %s\n", path.c_str());
+            return 1;
+        }
+        for (auto &w : stim)
+            fprintf(f, "%08x%08x\n", w.first, w.second);
+        fclose(f);
+        return 0;
+    }
+
+    std::vector<std::vector<string>> rtl_bus, rtl_mem;
+    if (read_dump(dir + "/rtl_bus.hex", rtl_bus) || read_dump(dir + "/rtl_mem.hex", rtl_mem))
+        return 1;
+    if ((int)rtl_bus.size() < runs || (int)rtl_mem.size() < runs)
+    {
+        printf("Seed %d: the RTL dumps hold %d runs, not %d\n", seed, (int)rtl_bus.size(), runs);
+        return 1;
+    }
+
+    string first;
+    int fails = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        int n = compare_bus(cpp[r], rtl_bus[r], offset, first);
+        if (n)
+            printf("Seed %d run %d: %d databus mismatches from RTL cycle %d, first at %s\n", seed, r, n, offset,
+                   first.c_str());
+        for (int k = 0; k < nSTAGE * nMEM * MEM_SIZE; k++)
+        {
+            uint32_t c = (uint32_t)cpp_mem[r][k] & DATAPATH_MASK;
+            uint32_t h = k < (int)rtl_mem[r].size() ? hex_field(rtl_mem[r][k], 0) : ~c;
+            if (c != h)
+            {
+                printf("Seed %d run %d: stage %d mem%d[%d]: C++ %x, RTL %x\n", seed, r, k / (nMEM * MEM_SIZE),
+                       k / MEM_SIZE % nMEM, k % MEM_SIZE, c, h);
+                n++;
+                break;
+            }
+        }
+        fails += n != 0;
+    }
+    if (fails == 0)
+        printf("Seed %d: %d runs match, RTL cycle %d is C++ cycle 0\n", seed, runs, offset);
+    return fails != 0;
+}
@@ -0,0 +1,273 @@
+#include "versat_sim.h"
+#include "versat.hpp"
+
+#ifdef VERSAT_NAMESPACE
+using namespace VERSAT_NAMESPACE;
+#endif
+
+struct versat_sim
+{
+    VersatInstance versat;
+    bool queued = 0; //a run was queued (VersatInstance::done() is 0 before)
+};
+
+int versat_sim_abi_version(void)
+{
+    return VERSAT_SIM_ABI_VERSION;
+}
+
+int versat_sim_word_size(void)
+{
+    return sizeof(versat_t);
+}
+
+#define PARAM(name) {#name, name}
+static const struct
+{
+    const char *name;
+    int val;
+} params[] = {
+    PARAM(nSTAGE), PARAM(DATAPATH_W), PARAM(nMEM), PARAM(nVI), PARAM(nVO), PARAM(nALU),
+    PARAM(nALULITE), PARAM(nMUL), PARAM(nMULADD), PARAM(nBS), PARAM(MEM_ADDR_W), PARAM(N_W),
+    PARAM(CONF_MEM_ADDR_W), PARAM(CONF_MEM0A), PARAM(CONF_VI0), PARAM(CONF_VO0), PARAM(CONF_ALU0),
+    PARAM(CONF_ALULITE0), PARAM(CONF_MUL0), PARAM(CONF_MULADD0), PARAM(CONF_BS0),
+    PARAM(CONF_CLEAR), PARAM(GLOBAL_CONF_CLEAR), PARAM(CONF_MEM),
+    PARAM(MEMP_CONF_ITER), PARAM(MEMP_CONF_PER), PARAM(MEMP_CONF_DUTY), PARAM(MEMP_CONF_SEL),
+    PARAM(MEMP_CONF_START), PARAM(MEMP_CONF_SHIFT), PARAM(MEMP_CONF_INCR), PARAM(MEMP_CONF_DELAY),
+    PARAM(MEMP_CONF_RVRS), PARAM(MEMP_CONF_EXT), PARAM(MEMP_CONF_IN_WR), PARAM(MEMP_CONF_ITER2),
+    PARAM(MEMP_CONF_PER2), PARAM(MEMP_CONF_SHIFT2), PARAM(MEMP_CONF_INCR2), PARAM(MEMP_CONF_OFFSET),
+    PARAM(ALU_CONF_SELA), PARAM(ALU_CONF_SELB), PARAM(ALU_CONF_FNS), PARAM(ALU_CONF_OFFSET),
+    PARAM(ALULITE_CONF_SELA), PARAM(ALULITE_CONF_SELB), PARAM(ALULITE_CONF_FNS), PARAM(ALULITE_CONF_OFFSET),
+    PARAM(MUL_CONF_SELA), PARAM(MUL_CONF_SELB), PARAM(MUL_CONF_FNS), PARAM(MUL_CONF_OFFSET),
+    PARAM(MULADD_CONF_SELA), PARAM(MULADD_CONF_SELB), PARAM(MULADD_CONF_FNS), PARAM(MULADD_CONF_ITER),
+    PARAM(MULADD_CONF_PER), PARAM(MULADD_CONF_DELAY), PARAM(MULADD_CONF_SHIFT), PARAM(MULADD_CONF_OFFSET),
+    PARAM(BS_CONF_SELD), PARAM(BS_CONF_SELS), PARAM(BS_CONF_FNS), PARAM(BS_CONF_OFFSET),
+    PARAM(MEMP_LAT), PARAM(ALU_LAT), PARAM(ALULITE_LAT), PARAM(MUL_LAT), PARAM(MULADD_LAT), PARAM(BS_LAT),
+#if nVI > 0
+    PARAM(VI_CONF_OFFSET),
+#endif
+#if nVO > 0
+    PARAM(VO_CONF_OFFSET),
+#endif
+};
+
+int versat_sim_param(const char *name)
+{
+    for (auto &p : params)
+        if (!strcmp(p.name, name))
+            return p.val;
+    return -1;
+}
+
+versat_sim *versat_sim_create(void)
+{
+    //value-initialized: memories and databus start zeroed, as in the
+    //static default instance
+    //no exception crosses the C interface: the run worker thread may fail
+    try
+    {
+        return new versat_sim();
+    }
+    catch (const std::exception &e)
+    {
+        printf("Cannot create Versat instance: %s\n", e.what());
+        return NULL;
+    }
+}
+
+void versat_sim_destroy(versat_sim *v)
+{
+    delete v;
+}
+
+int versat_sim_load_topology(versat_sim *v, const char *path)
+{
+    return v->versat.load_topology(path);
+}
+
+int versat_sim_set_engine(versat_sim *v, int engine)
+{
+    if (engine < VERSAT_ENGINE_OBJ || engine > VERSAT_ENGINE_COMPILED)
+    {
+        printf("Invalid engine %d\n", engine);
+        return -1;
+    }
+    v->versat.set_engine(engine);
+    return 0;
+}
+
+int versat_sim_set_threads(versat_sim *v, int n)
+{
+    v->versat.set_sim_threads(n);
+    return 0;
+}
+
+static bool valid_stage(int stage)
+{
+    if (stage >= 0 && stage < nSTAGE)
+        return true;
+    printf("Invalid stage %d\n", stage);
+    return false;
+}
+
+int versat_sim_conf_write(versat_sim *v, int stage, int addr, int val)
+{
+    if (!valid_stage(stage))
+        return -1;
+    CStage &st = v->versat.stage[stage];
+    if (addr == CONF_CLEAR)
+        st.clearConf();
+    else if (addr == GLOBAL_CONF_CLEAR)
+        v->versat.globalClearConf();
+#ifdef CONF_MEM_USE
+    else if (addr >= CONF_MEM && addr < CONF_MEM + CONF_MEM_SIZE)
+        st.confMemWrite(addr - CONF_MEM);
+#endif
+    else if (int *f = st.conf_field(addr))
+        *f = val;
+    else
+    {
+        printf("Invalid CONF ADDR %d\n", addr);
+        return -1;
+    }
+    return 0;
+}
+
+int versat_sim_conf_read(versat_sim *v, int stage, int addr, int *val)
+{
+    if (!valid_stage(stage))
+        return -1;
+    CStage &st = v->versat.stage[stage];
+#ifdef CONF_MEM_USE
+    if (addr >= CONF_MEM && addr < CONF_MEM + CONF_MEM_SIZE)
+    {
+        st.confMemRead(addr - CONF_MEM);
+        *val = 0;
+        return 0;
+    }
+#endif
+    int *f = st.conf_field(addr);
+    if (!f)
+    {
+        printf("Invalid CONF ADDR %d\n", addr);
+        return -1;
+    }
+    *val = *f;
+    return 0;
+}
+
+int versat_sim_sel(versat_sim *v, int kind, int index, int prev)
+{
+    VersatInstance &u = v->versat;
+    switch (kind)
+    {
+#if nMEM > 0
+    case VERSAT_SIM_MEMA:
+        if (index >= 0 && index < nMEM)
+            return prev ? u.sMEMA_p[index] : u.sMEMA[index];
+        break;
+    case VERSAT_SIM_MEMB:
+        if (index >= 0 && index < nMEM)
+            return prev ? u.sMEMB_p[index] : u.sMEMB[index];
+        break;
+#endif
+#if nVI > 0
+    case VERSAT_SIM_VI:
+        if (index >= 0 && index < nVI)
+            return prev ? u.sVI_p[index] : u.sVI[index];
+        break;
+#endif
+#if nALU > 0
+    case VERSAT_SIM_ALU:
+        if (index >= 0 && index < nALU)
+            return prev ? u.sALU_p[index] : u.sALU[index];
+        break;
+#endif
+#if nALULITE > 0
+    case VERSAT_SIM_ALULITE:
+        if (index >= 0 && index < nALULITE)
+            return prev ? u.sALULITE_p[index] : u.sALULITE[index];
+        break;
+#endif
+#if nMUL > 0
+    case VERSAT_SIM_MUL:
+        if (index >= 0 && index < nMUL)
+            return prev ? u.sMUL_p[index] : u.sMUL[index];
+        break;
+#endif
+#if nMULADD > 0
+    case VERSAT_SIM_MULADD:
+        if (index >= 0 && index < nMULADD)
+            return prev ? u.sMULADD_p[index] : u.sMULADD[index];
+        break;
+#endif
+#if nBS > 0
+    case VERSAT_SIM_BS:
+        if (index >= 0 && index < nBS)
+            return prev ? u.sBS_p[index] : u.sBS[index];
+        break;
+#endif
+    }
+    return -1;
+}
+
+void *versat_sim_mem(versat_sim *v, int s, int m)
+{
+    if (s < 0 || s >= v->versat.topo.n_stage || m < 0 || m >= v->versat.topo.n_mem)
+        return NULL;
+    return v->versat.versat_mem[s][m].ptr();
+}
+
+int versat_sim_mem_size(versat_sim *v)
+{
+    return v->versat.mem_size();
+}
+
+int versat_sim_set_ext_mem(versat_sim *v, void *mem, uint32_t words)
+{
+    v->versat.set_ext_mem((versat_t *)mem, words);
+    return 0;
+}
+
+int versat_sim_run(versat_sim *v)
+{
+    v->queued = 1;
+    v->versat.run();
+    return 0;
+}
+
+int versat_sim_done(versat_sim *v)
+{
+    return !v->queued || v->versat.done();
+}
+
+int versat_sim_wait(versat_sim *v)
+{
+    v->versat.wait();
+    return v->versat.versat_iter;
+}
+
+int versat_sim_save_conf(versat_sim *v, const char *path)
+{
+    return v->versat.save_conf(path);
+}
+
+int versat_sim_load_conf(versat_sim *v, const char *path)
+{
+    return v->versat.load_conf(path);
+}
+
+int versat_sim_save_checkpoint(versat_sim *v, const char *path)
+{
+    return v->versat.save_checkpoint(path);
+}
+
+int versat_sim_load_checkpoint(versat_sim *v, const char *path)
+{
+    return v->versat.load_checkpoint(path);
+}
+
+int versat_sim_save_run_stats(versat_sim *v, const char *path)
+{
+    return v->versat.save_run_stats(path);
+}
@@ -0,0 +1,98 @@
+#ifndef VERSAT_SIM_H
+#define VERSAT_SIM_H
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// C interface of the PC simulator (libversat_sim.so)
+// One library is one build of versat.h. Hosts that are not C++ (Python
+// through ctypes, ...) create instances, configure them with the register
+// writes of the firmware (xconfdefs.vh), run them and access the memory
+// banks in place: versat_sim_mem() points at the simulated memory, so
+// host arrays wrap it without copies. Functions returning int return 0,
+// or -1 with a message, unless stated otherwise.
+// The layout of the calls below only changes with VERSAT_SIM_ABI_VERSION.
+//
+#define VERSAT_SIM_ABI_VERSION 1
+
+//FU kinds of versat_sim_sel()
+#define VERSAT_SIM_MEMA 0
+#define VERSAT_SIM_MEMB 1
+#define VERSAT_SIM_VI 2
+#define VERSAT_SIM_ALU 3
+#define VERSAT_SIM_ALULITE 4
+#define VERSAT_SIM_MUL 5
+#define VERSAT_SIM_MULADD 6
+#define VERSAT_SIM_BS 7
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct versat_sim versat_sim;
+
+//VERSAT_SIM_ABI_VERSION of the library
+int versat_sim_abi_version(void);
+
+//bytes per datapath word (versat_t, signed)
+int versat_sim_word_size(void);
+
+//constant name of the build (nSTAGE, MEM_ADDR_W, CONF_ALU0,
+//MEMP_CONF_ITER, MEMP_LAT, CONF_CLEAR ...), -1 if unknown
+int versat_sim_param(const char *name);
+
+//new instance of the build topology, NULL on failure
+versat_sim *versat_sim_create(void);
+void versat_sim_destroy(versat_sim *v);
+
+//simulate the topology of the xversat.json at path (runtime topology)
+int versat_sim_load_topology(versat_sim *v, const char *path);
+
+//simulation engine (0 object, 1 SoA, 2 compiled) and stage threads
+int versat_sim_set_engine(versat_sim *v, int engine);
+int versat_sim_set_threads(versat_sim *v, int n);
+
+//write/read configuration register addr of stage: the fields of the
+//stage map, CONF_CLEAR, GLOBAL_CONF_CLEAR and, with CONF_MEM_USE,
+//CONF_MEM + i (a write stores the stage configuration in entry i,
+//a read restores it and reads 0)
+int versat_sim_conf_write(versat_sim *v, int stage, int addr, int val);
+int versat_sim_conf_read(versat_sim *v, int stage, int addr, int *val);
+
+//databus selector of FU index of kind (VERSAT_SIM_MEMA ...), of the
+//current (prev = 0) or previous stage; -1 if it does not exist
+int versat_sim_sel(versat_sim *v, int kind, int index, int prev);
+
+//memory m of stage s, versat_sim_mem_size() words; NULL if it does not
+//exist. Only valid between runs: wait before touching it
+void *versat_sim_mem(versat_sim *v, int s, int m);
+int versat_sim_mem_size(versat_sim *v);
+
+//external memory of the VI/VO, words of versat_sim_word_size(), owned
+//by the caller until replaced
+int versat_sim_set_ext_mem(versat_sim *v, void *mem, uint32_t words);
+
+//queue a run of the current configuration
+int versat_sim_run(versat_sim *v);
+
+//1 when all queued runs have finished, also before the first run
+int versat_sim_done(versat_sim *v);
+
+//wait for the queued runs, return the clock cycles of the last one
+int versat_sim_wait(versat_sim *v);
+
+//configuration of all stages to/from a file of packed configuration
+//registers (confimg.hpp)
+int versat_sim_save_conf(versat_sim *v, const char *path);
+int versat_sim_load_conf(versat_sim *v, const char *path);
+
+//whole instance to/from a checkpoint file, per-FU stats of the last run
+//as JSON
+int versat_sim_save_checkpoint(versat_sim *v, const char *path);
+int versat_sim_load_checkpoint(versat_sim *v, const char *path);
+int versat_sim_save_run_stats(versat_sim *v, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
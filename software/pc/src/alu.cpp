@@ -1,12 +1,15 @@
-#include "alu.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 #if nALU > 0
 
 CALU::CALU()
 {
 }
 
-CALU::CALU(int versat_base, int i, versat_t *databus)
+CALU::CALU(VersatInstance *versat, int versat_base, int i, versat_t *databus)
 {
+    this->versat = versat;
     this->versat_base = versat_base;
     this->alu_base = i;
     this->databus = databus;
@@ -19,103 +22,31 @@ void CALU::start_run()
 
 void CALU::update()
 {
-    int i = 0;
-
-    //update databus
-    databus[sALU[alu_base]] = output_buff[ALU_LAT - 1];
+    //shift output pipeline, update databus
+    versat_t data = output_buff.push(out);
+    databus[versat->sALU[alu_base]] = data;
     //special case for stage 0
     if (versat_base == 0)
     {
         //2nd copy at the end of global databus
-        global_databus[nSTAGE * (1 << (N_W - 1)) + sALU[alu_base]] = output_buff[ALU_LAT - 1];
+        versat->global_databus[versat->ring_copy + versat->sALU[alu_base]] = data;
     }
-
-    //trickle down all outputs in buffer
-    versat_t aux_output = output_buff[0];
-    versat_t aux_output2 = 0;
-    //trickle down all outputs in buffer
-    for (i = 1; i < ALU_LAT; i++)
-    {
-        aux_output2 = output_buff[i];
-        output_buff[i] = aux_output;
-        aux_output = aux_output2;
-    }
-    //insert new output
-    output_buff[0] = out;
 }
 
 versat_t CALU::output()
 {
-    inb = databus[opa];
-    ina = databus[opb];
-    bitset<DATAPATH_W> aux_sext;
-    bitset<DATAPATH_W> aux_cmp;
-    uint8_t aux_a = ina;
-    bool val;
-    shift_t aux = ina;
-    shift_t ina_uns = ina;
-    shift_t inb_uns = inb;
-
-    switch (fns)
-    {
-    case ALU_OR:
-        out = inb | ina;
-        break;
-    case ALU_AND:
-        out = inb & ina;
-        break;
-    case ALU_XOR:
-        out = inb ^ ina;
-        break;
-    case ALU_SEXT8:
-        aux_a = ina;
-        val = MSB(aux_a, 8);
-        SET_BITS_SEXT8(aux_sext, val, DATAPATH_W);
-        out = aux_sext.to_ulong() + aux_a;
-        break;
-    case ALU_SEXT16:
-        val = MSB(aux_a, 16);
-        SET_BITS_SEXT16(aux_sext, val, DATAPATH_W);
-        out = aux_sext.to_ulong() + aux_a;
-        break;
-    case ALU_SHIFTR_ARTH:
-        out = ina >> 1;
-        break;
-    case ALU_SHIFTR_LOG:
-        aux = aux >> 1;
-        out = (versat_t)aux;
-        break;
-    case ALU_CMP_SIG:
-        aux_cmp.set(DATAPATH_W - 1, ina > inb ? 1 : 0);
-        out = (versat_t)aux_cmp.to_ulong();
-        break;
-    case ALU_CMP_UNS:
-        ina_uns = ina;
-        inb_uns = inb;
-        aux_cmp.set(DATAPATH_W - 1, ina_uns > inb_uns ? 1 : 0);
-        out = (versat_t)aux_cmp.to_ulong();
-        break;
-    case ALU_MUX:
-        out = ina < 0 ? inb : 0;
-        break;
-    case ALU_ADD:
-        out = ina + inb;
-        break;
-    case ALU_SUB:
-        out = inb - ina;
-        break;
-    case ALU_MAX:
-        out = ina > inb ? ina : inb;
-        break;
-    case ALU_MIN:
-        out = ina < inb ? ina : inb;
-        break;
-    default:
-        break;
-    }
+    ina = databus[opa];
+    inb = databus[opb];
+    out = alu_op<versat_t>(fns, ina, inb);
     return out;
 }
 
+bool CALU::steady()
+{
+    return ina == databus[opa] && inb == databus[opb] && out == alu_op<versat_t>(fns, ina, inb) &&
+           output_buff.uniform(out) && databus[versat->sALU[alu_base]] == out;
+}
+
 void CALU::setOpA(int opa)
 {
     this->opa = opa;
@@ -138,6 +69,19 @@ void CALU::copy(CALU that)
     this->opb = that.opb;
     this->fns = that.fns;
 }
+
+void CALU::state(CCheckpoint &c)
+{
+    c.io(versat_base);
+    c.io(alu_base);
+    c.io(opa);
+    c.io(opb);
+    c.io(fns);
+    c.io(ina);
+    c.io(inb);
+    c.io(out);
+    output_buff.state(c);
+}
 string CALU::info()
 {
     string ver = "alu[" + to_string(alu_base) + "]\n";
@@ -163,4 +107,5 @@ string CALU::info_iter()
     ver += "\n";
     return ver;
 }
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
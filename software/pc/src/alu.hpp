@@ -1,21 +1,31 @@
+#ifndef VERSAT_ALU_HPP
+#define VERSAT_ALU_HPP
 #include "type.hpp"
+#include "delay_line.hpp"
+#include "alu_kernels.hpp"
+
+VERSAT_NS_BEGIN
 
 #if nALU > 0
 
 class CALU
 {
+    friend class CSoAEngine;   //packs the unit state
+    friend class CCompiledRun; //specialized steps
+
 private:
     versat_t ina = 0, inb = 0, out = 0;
-    versat_t output_buff[ALU_LAT]; //output FIFO
+    CDelayLine<ALU_LAT> output_buff; //output pipeline
     versat_t *databus = NULL;
 
 public:
+    VersatInstance *versat = NULL;
     int versat_base, alu_base;
     int opa = 0, opb = 0, fns = 0;
 
     //Default constructor
     CALU();
-    CALU(int versat_base, int i, versat_t *databus);
+    CALU(VersatInstance *versat, int versat_base, int i, versat_t *databus);
 
     //start run
     void start_run();
@@ -23,7 +33,12 @@ public:
     //update output buffer, write results to databus
     void update();
     versat_t output();
+    //output, inputs and pipeline at a fixed point of the current databus:
+    //as long as the databus holds, further cycles change nothing
+    bool steady();
     void copy(CALU that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
 
     void setOpA(int opa);
     void setOpB(int opb);
@@ -34,6 +49,6 @@ public:
 
 }; //end class CALU
 
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-extern int sALU[nALULITE];
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
+#endif
@@ -0,0 +1,164 @@
+#ifndef VERSAT_ALU_KERNELS_HPP
+#define VERSAT_ALU_KERNELS_HPP
+#include "type.hpp"
+#include <stdint.h>
+#include <type_traits>
+
+VERSAT_NS_BEGIN
+
+//
+// FU functions on native integers for any datapath type T
+// (int8_t, int16_t, int32_t), shared by the object and SoA engines
+// ALU and ALULite are bit exact with xalu.v and xalulite.v
+// a is the operand selected by sela (opa), b the one selected by selb (opb)
+//
+
+//fns bit selecting the feedback version of an ALULite function
+//(xalulitedefs.vh: concat a 1 to the left of the function)
+#define ALULITE_SELF_LOOP 0x8
+
+template <typename T>
+struct CALUBits
+{
+    typedef typename std::make_unsigned<T>::type U;
+    static const int W = sizeof(T) * 8;
+    static const U MSB = (U)((U)1 << (W - 1));
+    //double width product (mul_t) and unsigned shift type (shift_t)
+    typedef typename std::conditional<sizeof(T) == 1, int16_t,
+                                      typename std::conditional<sizeof(T) == 2, int32_t, int64_t>::type>::type M;
+    typedef typename std::make_unsigned<M>::type S;
+};
+
+//count leading zeros of a W bit value, W when zero (xclz.v)
+template <typename T>
+inline T alu_clz(T a)
+{
+    typedef typename CALUBits<T>::U U;
+    U ua = (U)a;
+    if (ua == 0)
+        return (T)CALUBits<T>::W;
+    return (T)(__builtin_clz((uint32_t)ua) - (32 - CALUBits<T>::W));
+}
+
+//sign extend the low bits of a, a itself when they fill the datapath
+template <typename T, typename S>
+inline T alu_sext(T a)
+{
+    return sizeof(S) >= sizeof(T) ? a : (T)(S)a;
+}
+
+//xalu.v: result of function fns (4 bits) on registered operands a and b
+template <typename T>
+inline T alu_op(int fns, T a, T b)
+{
+    typedef typename CALUBits<T>::U U;
+    const U msb = CALUBits<T>::MSB;
+    U ua = (U)a, ub = (U)b;
+
+    switch (fns & 0xF)
+    {
+    case ALU_ADD:
+        return (T)(ub + ua);
+    case ALU_SUB:
+        return (T)(ub - ua);
+    case ALU_CMP_SIG:
+        //adder computes b - a, its carry out replaces the MSB
+        return (T)(((ub - ua) & ~msb) | (a > b ? msb : 0));
+    case ALU_CMP_UNS:
+        return (T)(((ub - ua) & ~msb) | (ua > ub ? msb : 0));
+    case ALU_MUX:
+        return a < 0 ? 0 : b;
+    case ALU_MAX:
+        return b >= a ? b : a;
+    case ALU_MIN:
+        return b >= a ? a : b;
+    case ALU_OR:
+        return (T)(ua | ub);
+    case ALU_AND:
+        return (T)(ua & ub);
+    case ALU_XOR:
+        return (T)(ua ^ ub);
+    case ALU_SEXT8:
+        return alu_sext<T, int8_t>(a);
+    case ALU_SEXT16:
+        return alu_sext<T, int16_t>(a);
+    case ALU_SHIFTR_ARTH:
+        return (T)(a >> 1);
+    case ALU_SHIFTR_LOG:
+        return (T)(ua >> 1);
+    case ALU_CLZ:
+        return alu_clz(a);
+    default: //ALU_ABS
+        return (T)(a < 0 ? (U)0 - ua : ua);
+    }
+}
+
+//xalulite.v: result of function fns on registered operands a and b,
+//fb is the previous result (flow_out), used by the feedback versions
+template <typename T>
+inline T alulite_op(int fns, T a, T b, T fb)
+{
+    typedef typename CALUBits<T>::U U;
+    const int W = CALUBits<T>::W;
+    const U msb = CALUBits<T>::MSB;
+    bool self_loop = fns & ALULITE_SELF_LOOP;
+    bool a_neg = a < 0;
+    T a_int = self_loop ? fb : a;
+    U ua = (U)a_int, ub = (U)b;
+
+    switch (fns & 0x7)
+    {
+    case ALULITE_ADD:
+        return self_loop && a_neg ? b : (T)(ua + ub);
+    case ALULITE_SUB:
+        return (T)(ub - ua);
+    case ALULITE_CMP_SIG:
+    {
+        //W+1 bit b - a_int, extended with the MSBs of op_b_reg and op_a_reg
+        uint64_t ext_b = ((uint64_t)(b < 0) << W) | ub;
+        uint64_t ext_a = ((uint64_t)a_neg << W) | ua;
+        U carry = (U)(((ext_b - ext_a) >> W) & 1);
+        return (T)(((ub - ua) & ~msb) | (carry ? msb : 0));
+    }
+    case ALULITE_MUX:
+        return a_neg ? b : self_loop ? fb : 0;
+    case ALULITE_MAX:
+        return self_loop && a_neg ? fb : b >= a_int ? b : a_int;
+    case ALULITE_MIN:
+        return self_loop && a_neg ? fb : b >= a_int ? a_int : b;
+    case ALULITE_OR:
+        return (T)(ua | ub);
+    default: //ALULITE_AND
+        return (T)(ua & ub);
+    }
+}
+
+//CMul: product of a and b
+template <typename T>
+inline T mul_op(int fns, T a, T b)
+{
+    typedef typename CALUBits<T>::M M;
+    M result_mult = (M)a * (M)b;
+    if (fns == MUL_HI)
+        return (T)((M)((typename CALUBits<T>::S)result_mult << 1) >> CALUBits<T>::W);
+    else if (fns == MUL_DIV2_HI)
+        return (T)(result_mult >> CALUBits<T>::W);
+    else // MUL_LO
+        return (T)result_mult;
+}
+
+//CBS: in shifted by the low 5 bits of shift (xbs.v shift_reg[4:0])
+template <typename T>
+inline T bs_op(int fns, T in, int shift)
+{
+    shift &= 31;
+    if (fns == BS_SHR_A)
+        return (T)((int32_t)in >> shift);
+    else if (fns == BS_SHR_L)
+        return (T)((typename CALUBits<T>::S)in >> shift);
+    else if (fns == BS_SHL)
+        return (T)((uint32_t)(typename CALUBits<T>::U)in << shift);
+    return in;
+}
+VERSAT_NS_END
+#endif
@@ -1,12 +1,15 @@
-#include "alu_lite.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 #if nALULITE > 0
 
 CALULite::CALULite()
 {
 }
 
-CALULite::CALULite(int versat_base, int i, versat_t *databus)
+CALULite::CALULite(VersatInstance *versat, int versat_base, int i, versat_t *databus)
 {
+    this->versat = versat;
     this->versat_base = versat_base;
     this->alulite_base = i;
     this->databus = databus;
@@ -19,86 +22,34 @@ void CALULite::start_run()
 
 void CALULite::update()
 {
-    int i = 0;
-
-    //update databus
-    //trickle down all outputs in buffer
-    versat_t aux_output = output_buff[0];
-    versat_t aux_output2 = 0;
-    //trickle down all outputs in buffer
-    for (i = 1; i < ALULITE_LAT; i++)
-    {
-        aux_output2 = output_buff[i];
-        output_buff[i] = aux_output;
-        aux_output = aux_output2;
-    }
-    //insert new output
-    output_buff[0] = out;
-
-    databus[sALULITE[alulite_base]] = output_buff[ALULITE_LAT - 1];
+    //shift output pipeline, update databus
+    versat_t data = output_buff.push(out);
+    databus[versat->sALULITE[alulite_base]] = data;
     //special case for stage 0
     if (versat_base == 0)
     {
         //2nd copy at the end of global databus
-        global_databus[nSTAGE * (1 << (N_W - 1)) + sALULITE[alulite_base]] = output_buff[ALULITE_LAT - 1];
+        versat->global_databus[versat->ring_copy + versat->sALULITE[alulite_base]] = data;
     }
 }
 
 versat_t CALULite::output()
 {
-    bitset<DATAPATH_W + 1> ai;
-    bitset<DATAPATH_W + 1> bz;
-    SET_BITS(ai, 0, DATAPATH_W + 1);
-    SET_BITS(bz, 1, DATAPATH_W + 1);
-    bitset<DATAPATH_W> aux_cmp;
-
-    //cast to int cin.to_ulong();
     ina = databus[opa];
-    loop = fns < 0 ? 1 : 0;
     inb = databus[opb];
+    loop = (fns & ALULITE_SELF_LOOP) ? 1 : 0;
     ina_loop = loop ? out : ina;
-
-    versat_t op_a_reg = ina;
-    versat_t self_loop = loop;
-    versat_t op_b_reg = inb;
-    versat_t op_a_int = ina_loop;
-
-    switch (fns)
-    {
-    case ALULITE_OR:
-        out = op_a_int | op_b_reg;
-        break;
-    case ALULITE_AND:
-        out = op_a_int & op_b_reg;
-        break;
-    case ALULITE_CMP_SIG:
-        aux_cmp.set(DATAPATH_W - 1, op_a_int > op_b_reg ? 1 : 0);
-        out = (versat_t)aux_cmp.to_ulong();
-        break;
-    case ALULITE_MUX:
-        out = op_a_reg < 0 ? op_b_reg : self_loop == 1 ? out : 0;
-        break;
-    case ALULITE_SUB:
-        out = op_a_reg < 0 ? op_b_reg : op_a_int - op_b_reg;
-        break;
-    case ALULITE_ADD:
-        out = op_a_int + op_b_reg;
-        if (self_loop)
-            out = op_a_reg < 0 ? op_b_reg : out;
-        break;
-    case ALULITE_MAX:
-        out = op_a_reg < 0 ? out : max(op_a_int, op_b_reg);
-        break;
-    case ALULITE_MIN:
-        out = op_a_reg < 0 ? out : min(op_a_int, op_b_reg);
-        break;
-    default:
-        break;
-    }
-
+    out = alulite_op<versat_t>(fns, ina, inb, out);
     return out;
 }
 
+bool CALULite::steady()
+{
+    return ina == databus[opa] && inb == databus[opb] && out == alulite_op<versat_t>(fns, ina, inb, out) &&
+           loop == ((fns & ALULITE_SELF_LOOP) ? 1 : 0) && ina_loop == (loop ? out : ina) &&
+           output_buff.uniform(out) && databus[versat->sALULITE[alulite_base]] == out;
+}
+
 void CALULite::setOpA(int opa)
 {
     this->opa = opa;
@@ -121,6 +72,21 @@ void CALULite::copy(CALULite that)
     this->opb = that.opb;
     this->fns = that.fns;
 }
+
+void CALULite::state(CCheckpoint &c)
+{
+    c.io(versat_base);
+    c.io(alulite_base);
+    c.io(opa);
+    c.io(opb);
+    c.io(fns);
+    c.io(ina);
+    c.io(inb);
+    c.io(out);
+    c.io(ina_loop);
+    c.io(loop);
+    output_buff.state(c);
+}
 string CALULite::info()
 {
     string ver = "alu_lite[" + to_string(alulite_base) + "]\n";
@@ -149,4 +115,5 @@ string CALULite::info_iter()
     ver += "\n";
     return ver;
 }
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
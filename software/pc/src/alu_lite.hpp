@@ -1,24 +1,32 @@
+#ifndef VERSAT_ALU_LITE_HPP
+#define VERSAT_ALU_LITE_HPP
 #include "type.hpp"
+#include "delay_line.hpp"
+#include "alu_kernels.hpp"
+
+VERSAT_NS_BEGIN
 
 #if nALULITE > 0
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-extern int sALULITE[nALULITE];
 class CALULite
 {
+    friend class CSoAEngine;   //packs the unit state
+    friend class CCompiledRun; //specialized steps
+
 private:
     versat_t ina = 0, inb = 0, out = 0;
     versat_t ina_loop = 0;
     versat_t loop = 0;
-    versat_t output_buff[ALULITE_LAT] = {0}; //output FIFO
+    CDelayLine<ALULITE_LAT> output_buff; //output pipeline
     versat_t *databus = NULL;
 
 public:
+    VersatInstance *versat = NULL;
     int versat_base, alulite_base;
     int opa = 0, opb = 0, fns = 0;
 
     //Default constructor
     CALULite();
-    CALULite(int versat_base, int i, versat_t *databus);
+    CALULite(VersatInstance *versat, int versat_base, int i, versat_t *databus);
 
     //start run
     void start_run();
@@ -26,7 +34,12 @@ public:
     //update output buffer, write results to databus
     void update();
     versat_t output();
+    //output, inputs and pipeline at a fixed point of the current databus:
+    //as long as the databus holds, further cycles change nothing
+    bool steady();
     void copy(CALULite that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
 
     void setOpA(int opa);
     void setOpB(int opb);
@@ -35,4 +48,6 @@ public:
     string info();
     string info_iter();
 }; //end class CALUALITE
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
+#endif
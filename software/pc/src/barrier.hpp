@@ -0,0 +1,57 @@
+#ifndef VERSAT_BARRIER_HPP
+#define VERSAT_BARRIER_HPP
+#include <atomic>
+#include <thread>
+
+//
+// Sense-reversing spin barrier used to keep the simulation threads
+// of one instance in lock step between the output and update phases.
+// Waiting threads spin for a while and then start yielding, so an
+// oversubscribed host still makes progress.
+//
+class CBarrier
+{
+private:
+    std::atomic<int> count;
+    std::atomic<bool> sense;
+    int n;
+
+public:
+    CBarrier(int n = 1) : count(n), sense(false), n(n) {}
+
+    //set number of participating threads (no thread may be waiting)
+    void init(int n)
+    {
+        this->n = n;
+        count.store(n, std::memory_order_relaxed);
+    }
+
+    //current sense, used by a thread to join the barrier
+    bool get_sense()
+    {
+        return sense.load(std::memory_order_acquire);
+    }
+
+    //block until all n threads have called wait()
+    //local_sense is owned by the calling thread
+    void wait(bool &local_sense)
+    {
+        local_sense = !local_sense;
+        if (count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            //last thread in releases the others
+            count.store(n, std::memory_order_relaxed);
+            sense.store(local_sense, std::memory_order_release);
+        }
+        else
+        {
+            int spin = 0;
+            while (sense.load(std::memory_order_acquire) != local_sense)
+            {
+                if (++spin > 1024)
+                    std::this_thread::yield();
+            }
+        }
+    }
+};
+#endif
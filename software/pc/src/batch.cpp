@@ -0,0 +1,345 @@
+#include "versat.hpp"
+#include <algorithm>
+
+VERSAT_NS_BEGIN
+
+void CBatchUnit::init(int lat, int lanes, bool accumulator)
+{
+    this->lat = lat;
+    head = 0;
+    out.assign(lanes, 0);
+    pipe.assign((size_t)lat * lanes, 0);
+    acc.assign(accumulator ? lanes : 0, 0);
+}
+
+//CDelayLine::push() on every lane
+const versat_t *CBatchUnit::push(int lanes)
+{
+    std::copy(out.begin(), out.end(), pipe.begin() + (size_t)head * lanes);
+    if (++head == lat)
+        head = 0;
+    return &pipe[(size_t)head * lanes];
+}
+
+CBatchRun::CBatchRun(VersatInstance *versat, int lanes)
+{
+    this->versat = versat;
+    n_lanes = lanes > 0 ? lanes : 1;
+    kernels = soa_kernels();
+    mem.assign((size_t)nSTAGE * nMEM * MEM_SIZE * n_lanes, 0);
+    bus.assign(sizeof(versat->global_databus) / sizeof(versat_t) * n_lanes, 0);
+    shift.assign(n_lanes, 0);
+    port.resize(nSTAGE * 2 * nMEM);
+    for (auto &u : port)
+        u.init(MEMP_LAT, n_lanes, 0);
+#if nALU > 0
+    alu.resize(nSTAGE * nALU);
+    for (auto &u : alu)
+        u.init(ALU_LAT, n_lanes, 0);
+#endif
+#if nALULITE > 0
+    alulite.resize(nSTAGE * nALULITE);
+    for (auto &u : alulite)
+        u.init(ALULITE_LAT, n_lanes, 0);
+#endif
+#if nMUL > 0
+    mul.resize(nSTAGE * nMUL);
+    for (auto &u : mul)
+        u.init(MUL_LAT, n_lanes, 0);
+#endif
+#if nMULADD > 0
+    muladd.resize(nSTAGE * nMULADD);
+    for (auto &u : muladd)
+        u.init(MULADD_LAT, n_lanes, 1);
+#endif
+#if nBS > 0
+    bs.resize(nSTAGE * nBS);
+    for (auto &u : bs)
+        u.init(BS_LAT, n_lanes, 0);
+#endif
+}
+
+//
+// lane memories
+//
+bool CBatchRun::check_range(const char *op, int lane, int s, int m, long addr, long last)
+{
+    if (lane < 0 || lane >= n_lanes || s < 0 || s >= nSTAGE || m < 0 || m >= nMEM)
+    {
+        printf("Invalid batch %s lane %d MEM_%d of nStage_%d\n", op, lane, m, s);
+        return false;
+    }
+    if (addr < 0 || addr >= versat->mem_size() || last < 0 || last >= versat->mem_size())
+    {
+        printf("Invalid %s MEM BLOCK ADDR=%ld..%ld\n", op, addr, last);
+        return false;
+    }
+    return true;
+}
+
+versat_t CBatchRun::read(int lane, int s, int m, int addr)
+{
+    if (!check_range("READ", lane, s, m, addr, addr))
+        return 0;
+    return lane_mem(s, m, addr)[lane];
+}
+
+void CBatchRun::write(int lane, int s, int m, int addr, versat_t val)
+{
+    if (check_range("WRITE", lane, s, m, addr, addr))
+        lane_mem(s, m, addr)[lane] = val;
+}
+
+void CBatchRun::write_block(int lane, int s, int m, int addr, const versat_t *src, int n)
+{
+    if (n > 0 && check_range("WRITE", lane, s, m, addr, (long)addr + n - 1))
+        for (int k = 0; k < n; k++)
+            lane_mem(s, m, addr + k)[lane] = src[k];
+}
+
+void CBatchRun::read_block(int lane, int s, int m, int addr, versat_t *dst, int n)
+{
+    if (n > 0 && check_range("READ", lane, s, m, addr, (long)addr + n - 1))
+        for (int k = 0; k < n; k++)
+            dst[k] = lane_mem(s, m, addr + k)[lane];
+}
+
+void CBatchRun::load(int lane)
+{
+    for (int s = 0; s < nSTAGE; s++)
+        for (int m = 0; m < nMEM; m++)
+            write_block(lane, s, m, 0, versat->versat_mem[s][m].ptr(), versat->mem_size());
+}
+
+void CBatchRun::store(int lane)
+{
+    for (int s = 0; s < nSTAGE; s++)
+        for (int m = 0; m < nMEM; m++)
+            read_block(lane, s, m, 0, versat->versat_mem[s][m].ptr(), versat->mem_size());
+}
+
+//
+// run
+//
+
+//write data to databus slot of stage s, CALU::update() on every lane
+void CBatchRun::drive(int s, int slot, const versat_t *data)
+{
+    std::copy(data, data + n_lanes, lane_bus(s, slot));
+    //special case for stage 0
+    if (s == 0)
+    {
+        //2nd copy at the end of global databus
+        std::copy(data, data + n_lanes, &bus[(size_t)(versat->ring_copy + slot) * n_lanes]);
+    }
+}
+
+//output phase of stage s: CStage::output_all_FUs() on every lane
+void CBatchRun::output(int s)
+{
+    CStage &st = versat->shadow_reg[s];
+    int i, mem_size = versat->mem_size();
+
+    st.wake_mem_ports();
+    for (i = 0; i < st.n_active_mem; i++)
+    {
+        int j = st.active_mem[i];
+        CMemPort &p = st.mem_port(j);
+        if (p.done)
+            continue;
+        uint32_t addr = p.next_addr();
+        versat_t *out = port[s * 2 * nMEM + j].out.data();
+        bool valid = addr < (uint32_t)mem_size;
+        if (p.in_wr == 1)
+        {
+            if (p.enable == 1)
+            {
+                const versat_t *in = lane_bus(s, p.sel);
+                if (valid)
+                    std::copy(in, in + n_lanes, lane_mem(s, p.mem_base, addr));
+                std::copy(in, in + n_lanes, out);
+            }
+        }
+        else if (valid)
+        {
+            const versat_t *data = lane_mem(s, p.mem_base, addr);
+            std::copy(data, data + n_lanes, out);
+        }
+        else
+            std::fill(out, out + n_lanes, 0);
+        if (!valid && (p.in_wr != 1 || p.enable == 1))
+        {
+            printf("Invalid %s MEM ADDR=%u\n", p.in_wr == 1 ? "WRITE" : "READ", addr);
+            printf("VERSAT EXITING ON nStage_%d MEM_%d[%d]\n", s, p.data_base, p.mem_base);
+        }
+    }
+#if nMULADD > 0
+    st.wake_muladds();
+#endif
+
+    //compute FUs: one kernel call for all lanes, as the SoA engine
+#if nALU > 0
+    for (i = 0; i < st.n_active_alu; i++)
+    {
+        CALU &o = st.alu[st.active_alu[i]];
+        kernels->alu[o.fns & 0xF](n_lanes, lane_bus(s, o.opa), lane_bus(s, o.opb),
+                                  alu[s * nALU + st.active_alu[i]].out.data());
+    }
+#endif
+#if nALULITE > 0
+    for (i = 0; i < st.n_active_alulite; i++)
+    {
+        CALULite &o = st.alulite[st.active_alulite[i]];
+        kernels->alulite[o.fns & 0xF](n_lanes, lane_bus(s, o.opa), lane_bus(s, o.opb),
+                                      alulite[s * nALULITE + st.active_alulite[i]].out.data());
+    }
+#endif
+#if nBS > 0
+    for (i = 0; i < st.n_active_bs; i++)
+    {
+        CBS &o = st.bs[st.active_bs[i]];
+        std::fill(shift.begin(), shift.end(), o.shift);
+        kernels->bs[o.fns >= 0 && o.fns < 3 ? o.fns : 3](n_lanes, lane_bus(s, o.data), shift.data(),
+                                                          bs[s * nBS + st.active_bs[i]].out.data());
+    }
+#endif
+#if nMUL > 0
+    for (i = 0; i < st.n_active_mul; i++)
+    {
+        CMul &o = st.mul[st.active_mul[i]];
+        kernels->mul[o.fns >= 0 && o.fns < 4 ? o.fns : 0](n_lanes, lane_bus(s, o.sela), lane_bus(s, o.selb),
+                                                           mul[s * nMUL + st.active_mul[i]].out.data());
+    }
+#endif
+#if nMULADD > 0
+    //CMulAdd::output(): the address generator once, the MAC on every lane
+    for (i = 0; i < st.n_active_muladd; i++)
+    {
+        CMulAdd &o = st.muladd[st.active_muladd[i]];
+        CBatchUnit &u = muladd[s * nMULADD + st.active_muladd[i]];
+        const versat_t *a = lane_bus(s, o.sela), *b = lane_bus(s, o.selb);
+        o.cnt_addr = o.acumulator();
+        o.accumulations += o.cnt_addr != 0;
+        if (o.cnt_addr == 0)
+            std::fill(u.acc.begin(), u.acc.end(), 0);
+        if (o.fns == MULADD_MACC)
+            for (int l = 0; l < n_lanes; l++)
+                u.acc[l] += (mul_t)a[l] * b[l];
+        else
+            for (int l = 0; l < n_lanes; l++)
+                u.acc[l] -= (mul_t)a[l] * b[l];
+        for (int l = 0; l < n_lanes; l++)
+            u.out[l] = (versat_t)(u.acc[l] >> o.shift);
+    }
+#endif
+}
+
+//update phase of stage s: CStage::update_all_FUs() on every lane
+void CBatchRun::update(int s)
+{
+    CStage &st = versat->shadow_reg[s];
+    int i;
+
+    for (i = 0; i < st.n_active_mem; i++)
+    {
+        int j = st.active_mem[i];
+        CMemPort &p = st.mem_port(j);
+        if (p.done)
+            p.done_cnt++;
+        drive(s, p.out_sel[p.mem_base], port[s * 2 * nMEM + j].push(n_lanes));
+        if (p.retired())
+        {
+            for (int k = i + 1; k < st.n_active_mem; k++)
+                st.active_mem[k - 1] = st.active_mem[k];
+            st.n_active_mem--;
+            i--;
+        }
+    }
+    st.cycle++;
+#if nALU > 0
+    for (i = 0; i < st.n_active_alu; i++)
+        drive(s, versat->sALU[st.active_alu[i]], alu[s * nALU + st.active_alu[i]].push(n_lanes));
+#endif
+#if nALULITE > 0
+    for (i = 0; i < st.n_active_alulite; i++)
+        drive(s, versat->sALULITE[st.active_alulite[i]], alulite[s * nALULITE + st.active_alulite[i]].push(n_lanes));
+#endif
+#if nBS > 0
+    for (i = 0; i < st.n_active_bs; i++)
+        drive(s, versat->sBS[st.active_bs[i]], bs[s * nBS + st.active_bs[i]].push(n_lanes));
+#endif
+#if nMUL > 0
+    for (i = 0; i < st.n_active_mul; i++)
+        drive(s, versat->sMUL[st.active_mul[i]], mul[s * nMUL + st.active_mul[i]].push(n_lanes));
+#endif
+#if nMULADD > 0
+    for (i = 0; i < st.n_active_muladd; i++)
+        drive(s, versat->sMULADD[st.active_muladd[i]], muladd[s * nMULADD + st.active_muladd[i]].push(n_lanes));
+#endif
+}
+
+//lane state of the FUs VersatInstance::drop_absent_FUs() sets back to reset
+void CBatchRun::drop_absent_FUs()
+{
+    const CTopology &t = versat->topo;
+    for (int s = 0; s < nSTAGE; s++)
+    {
+        for (int j = 0; j < 2 * nMEM; j++)
+            if (s >= t.n_stage || j % nMEM >= t.n_mem)
+                port[s * 2 * nMEM + j].init(MEMP_LAT, n_lanes, 0);
+        if (s < t.n_stage)
+            continue;
+#if nALU > 0
+        for (int j = 0; j < nALU; j++)
+            alu[s * nALU + j].init(ALU_LAT, n_lanes, 0);
+#endif
+#if nALULITE > 0
+        for (int j = 0; j < nALULITE; j++)
+            alulite[s * nALULITE + j].init(ALULITE_LAT, n_lanes, 0);
+#endif
+#if nMUL > 0
+        for (int j = 0; j < nMUL; j++)
+            mul[s * nMUL + j].init(MUL_LAT, n_lanes, 0);
+#endif
+#if nMULADD > 0
+        for (int j = 0; j < nMULADD; j++)
+            muladd[s * nMULADD + j].init(MULADD_LAT, n_lanes, 1);
+#endif
+#if nBS > 0
+        for (int j = 0; j < nBS; j++)
+            bs[s * nBS + j].init(BS_LAT, n_lanes, 0);
+#endif
+    }
+}
+
+int CBatchRun::run()
+{
+    int s, cycles = 0;
+    bool run_mem = 0;
+
+    drop_absent_FUs();
+    //databus cleared at run start, as CStage::reset()
+    std::fill(bus.begin(), bus.end(), 0);
+    for (s = 0; s < nSTAGE; s++)
+        block[s] = versat->databus_block(s);
+
+    while (!run_mem)
+    {
+        //calculate new outputs
+        for (s = 0; s < nSTAGE; s++)
+            output(s);
+
+        //update output buffers and datapath
+        for (s = 0; s < nSTAGE; s++)
+            update(s);
+
+        //CStage::done() without the VI/VO, absent in batched runs
+        run_mem = 1;
+        for (s = 0; s < nSTAGE && run_mem; s++)
+            for (int j = 0; j < 2 * nMEM; j++)
+                run_mem = run_mem && versat->shadow_reg[s].mem_port(j).done;
+        cycles++;
+    }
+    return cycles;
+}
+VERSAT_NS_END
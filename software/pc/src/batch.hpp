@@ -0,0 +1,85 @@
+#ifndef VERSAT_BATCH_HPP
+#define VERSAT_BATCH_HPP
+#include "type.hpp"
+#include "soa.hpp"
+#include <vector>
+
+VERSAT_NS_BEGIN
+
+//
+// Batched runs
+// One configuration simulated on lanes independent data sets at once.
+// Memories, databus and the compute FU pipelines hold one word per lane,
+// lane minor, so each FU evaluates all the lanes of a cycle with one SoA
+// kernel call (soa.hpp) and each mem port moves them with one copy.
+// The control - AGUs, start delays, FU lists, run end - is the same for
+// every lane: it is evaluated once per cycle by the FU objects of
+// shadow_reg, as in a scalar run. Lane memories and FU state are owned
+// by the batch and persist across its runs; load()/store() copy the
+// memories of the instance to and from a lane. VI/VO are not batched.
+//
+
+//lane state of one FU: new output and output pipeline
+struct CBatchUnit
+{
+    int lat = 1, head = 0;
+    std::vector<versat_t> out;  //lanes
+    std::vector<versat_t> pipe; //lat x lanes, oldest at head
+    std::vector<mul_t> acc;     //MulAdd accumulator, lanes
+
+    void init(int lat, int lanes, bool accumulator);
+    //insert out in the pipeline, return the lanes leaving it
+    const versat_t *push(int lanes);
+};
+
+class CBatchRun
+{
+public:
+    //lanes data sets of versat, zeroed
+    CBatchRun(VersatInstance *versat, int lanes);
+
+    int lanes() { return n_lanes; }
+    VersatInstance *instance() { return versat; }
+
+    //word addr of memory m of stage s in lane
+    versat_t read(int lane, int s, int m, int addr);
+    void write(int lane, int s, int m, int addr, versat_t val);
+
+    //block copies from/to host buffers, nothing is copied if the block
+    //does not fit in the memory
+    void write_block(int lane, int s, int m, int addr, const versat_t *src, int n);
+    void read_block(int lane, int s, int m, int addr, versat_t *dst, int n);
+
+    //all the memories of the instance (versat_mem) to lane, and back
+    void load(int lane);
+    void store(int lane);
+
+    //simulate the configuration in versat->shadow_reg on every lane until
+    //all mem ports are done, after start_run() and build_active_FUs()
+    //returns the number of cycles (VersatInstance::run_batch())
+    int run();
+
+private:
+    VersatInstance *versat;
+    int n_lanes;
+    const CSoAKernels *kernels;
+
+    std::vector<versat_t> mem; //nSTAGE x nMEM x MEM_SIZE x lanes
+    std::vector<versat_t> bus; //global databus x lanes
+    int block[nSTAGE];         //global databus index of each stage
+
+    //per stage, indexed as in CStage
+    std::vector<CBatchUnit> port, alu, alulite, mul, muladd, bs;
+    std::vector<int> shift; //BS shift, lanes
+
+    versat_t *lane_bus(int s, int sel) { return &bus[(size_t)(block[s] + sel) * n_lanes]; }
+    versat_t *lane_mem(int s, int m, int addr) { return &mem[((size_t)(s * nMEM + m) * MEM_SIZE + addr) * n_lanes]; }
+    bool check_range(const char *op, int lane, int s, int m, long addr, long last);
+
+    void drop_absent_FUs();
+    void output(int s);
+    void update(int s);
+    void drive(int s, int slot, const versat_t *data);
+};
+VERSAT_NS_END
+#endif
@@ -1,12 +1,15 @@
-#include "bs.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 #if nBS > 0
 
 CBS::CBS()
 {
 }
 
-CBS::CBS(int versat_base, int i, versat_t *databus)
+CBS::CBS(VersatInstance *versat, int versat_base, int i, versat_t *databus)
 {
+    this->versat = versat;
     this->versat_base = versat_base;
     this->bs_base = i;
     this->databus = databus;
@@ -19,54 +22,33 @@ void CBS::start_run()
 
 void CBS::update()
 {
-    int i = 0;
-
-    //update databus
-    databus[sBS[bs_base]] = output_buff[BS_LAT - 1];
+    //shift output pipeline, update databus
+    versat_t data = output_buff.push(out);
+    databus[versat->sBS[bs_base]] = data;
     //special case for stage 0
     if (versat_base == 0)
     {
         //2nd copy at the end of global databus
-        global_databus[nSTAGE * (1 << (N_W - 1)) + sBS[bs_base]] = output_buff[BS_LAT - 1];
-    }
-
-    //trickle down all outputs in buffer
-    versat_t aux_output = output_buff[0];
-    versat_t aux_output2 = 0;
-    //trickle down all outputs in buffer
-    for (i = 1; i < BS_LAT; i++)
-    {
-        aux_output2 = output_buff[i];
-        output_buff[i] = aux_output;
-        aux_output = aux_output2;
+        versat->global_databus[versat->ring_copy + versat->sBS[bs_base]] = data;
     }
-    //insert new output
-    output_buff[0] = out;
 }
 
 versat_t CBS::output()
 {
     in = databus[data];
-    if (fns == BS_SHR_A)
-    {
-        in = in >> shift;
-    }
-    else if (fns == BS_SHR_L)
-    {
-        shift_t s = in;
-        s = s >> shift;
-        in = s;
-    }
-    else if (fns == BS_SHL)
-    {
-        in = in << shift;
-    }
+    in = bs_op<versat_t>(fns, in, shift);
 
     out = in;
 
     return out;
 }
 
+bool CBS::steady()
+{
+    return in == out && out == bs_op<versat_t>(fns, databus[data], shift) &&
+           output_buff.uniform(out) && databus[versat->sBS[bs_base]] == out;
+}
+
 void CBS::setData(int data)
 {
     this->data = data;
@@ -89,6 +71,18 @@ void CBS::copy(CBS that)
     this->shift = that.shift;
     this->fns = that.fns;
 }
+
+void CBS::state(CCheckpoint &c)
+{
+    c.io(versat_base);
+    c.io(bs_base);
+    c.io(data);
+    c.io(shift);
+    c.io(fns);
+    c.io(in);
+    c.io(out);
+    output_buff.state(c);
+}
 string CBS::info()
 {
     string ver = "bs[" + to_string(bs_base) + "]\n";
@@ -112,4 +106,5 @@ string CBS::info_iter()
     ver += "\n";
     return ver;
 }
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
@@ -1,20 +1,30 @@
+#ifndef VERSAT_BS_HPP
+#define VERSAT_BS_HPP
 #include "type.hpp"
+#include "delay_line.hpp"
+#include "alu_kernels.hpp"
+
+VERSAT_NS_BEGIN
 
 #if nBS > 0
 class CBS
 {
+    friend class CSoAEngine;   //packs the unit state
+    friend class CCompiledRun; //specialized steps
+
 private:
     versat_t in = 0, out = 0;
-    versat_t output_buff[BS_LAT]; //output FIFO
+    CDelayLine<BS_LAT> output_buff; //output pipeline
     versat_t *databus = NULL;
 
 public:
+    VersatInstance *versat = NULL;
     int versat_base, bs_base;
     int data = 0, shift = 0, fns = 0;
 
     //Default constructor
     CBS();
-    CBS(int versat_base, int i, versat_t *databus);
+    CBS(VersatInstance *versat, int versat_base, int i, versat_t *databus);
 
     //set BS configuration to shadow register
 
@@ -25,7 +35,12 @@ public:
     void update();
 
     versat_t output();
+    //output, inputs and pipeline at a fixed point of the current databus:
+    //as long as the databus holds, further cycles change nothing
+    bool steady();
     void copy(CBS that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
 
     void setData(int data);
     void setShift(int shift);
@@ -36,6 +51,6 @@ public:
 
 }; //end class CBS
 
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-extern int sBS[nALULITE];
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
+#endif
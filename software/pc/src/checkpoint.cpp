@@ -0,0 +1,140 @@
+#include "versat.hpp"
+#include <stddef.h>
+
+VERSAT_NS_BEGIN
+
+CCheckpointHeader checkpoint_header()
+{
+    CCheckpointHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.version = CHECKPOINT_VERSION;
+    h.word_size = sizeof(versat_t);
+    h.datapath_w = DATAPATH_W;
+    h.mem_addr_w = MEM_ADDR_W;
+#ifdef CONF_MEM_USE
+    h.conf_mem_size = CONF_MEM_SIZE;
+#endif
+    h.n_stage = nSTAGE;
+    h.n_mem = nMEM;
+    h.n_vi = nVI;
+    h.n_vo = nVO;
+    h.n_alu = nALU;
+    h.n_alulite = nALULITE;
+    h.n_mul = nMUL;
+    h.n_muladd = nMULADD;
+    h.n_bs = nBS;
+    return h;
+}
+
+//everything but the pointers, in a fixed order
+void VersatInstance::state(CCheckpoint &c)
+{
+    int i;
+
+    CCheckpointHeader h = checkpoint_header(), expected = h;
+    c.io(h);
+    if (c.loading)
+    {
+        //whole checkpoint of this topology, or nothing is loaded
+        expected.size = c.data.size();
+        if (c.error || memcmp(&h, &expected, sizeof(h)) != 0)
+        {
+            c.error = 1;
+            return;
+        }
+    }
+    //same ring and FUs: the databus layout depends on them
+    CTopology t = topo;
+    c.io(t);
+    if (c.loading && (c.error || memcmp(&t, &topo, sizeof(t)) != 0))
+    {
+        c.error = 1;
+        return;
+    }
+
+    c.io(versat_iter);
+    c.io(run_paused);
+    for (i = 0; i < nSTAGE; i++)
+    {
+        stage[i].state(c);
+        shadow_reg[i].state(c);
+    }
+#ifdef CONF_MEM_USE
+    for (i = 0; i < nSTAGE; i++)
+        for (int j = 0; j < CONF_MEM_SIZE; j++)
+            conf_mem[i][j].state(c);
+    c.io(conf_mem_cycles);
+#endif
+    c.io(versat_mem);
+#if nVI > 0
+    c.io(vi_mem);
+#endif
+#if nVO > 0
+    c.io(vo_mem);
+#endif
+    c.io(global_databus);
+}
+
+std::vector<char> VersatInstance::checkpoint()
+{
+    wait();
+    CCheckpoint c;
+    state(c);
+    //total size, checked by restore()
+    uint64_t size = c.data.size();
+    memcpy(&c.data[offsetof(CCheckpointHeader, size)], &size, sizeof(size));
+    return c.data;
+}
+
+int VersatInstance::restore(const std::vector<char> &data)
+{
+    wait();
+    CCheckpoint c;
+    c.data = data;
+    c.loading = 1;
+    state(c);
+    if (c.error)
+    {
+        printf("Invalid checkpoint for this Versat\n");
+        return -1;
+    }
+    return 0;
+}
+
+int VersatInstance::save_checkpoint(const char *path)
+{
+    std::vector<char> data = checkpoint();
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    size_t n = fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+    if (n != data.size())
+    {
+        printf("Cannot write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int VersatInstance::load_checkpoint(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    std::vector<char> data;
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return restore(data);
+}
+VERSAT_NS_END
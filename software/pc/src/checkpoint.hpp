@@ -0,0 +1,62 @@
+#ifndef VERSAT_CHECKPOINT_HPP
+#define VERSAT_CHECKPOINT_HPP
+#include "type.hpp"
+#include <string.h>
+#include <vector>
+
+VERSAT_NS_BEGIN
+
+//
+// Simulator checkpoint
+// A flat byte buffer holding the state of a whole instance. Every class
+// with state has a state(CCheckpoint &c) method listing its fields once,
+// with c.io(field), so the same code saves (loading == 0) and loads it.
+// Pointers are not saved: they are fixed by the constructors of the
+// instance the checkpoint is loaded into. Derived run data (FU lists,
+// AGU streams, compiled chains) is rebuilt when a run resumes.
+//
+#define CHECKPOINT_MAGIC "VERSATCP"
+#define CHECKPOINT_VERSION 3
+
+//format and topology of the build, then the total size of the checkpoint
+//(the runtime topology, CTopology, follows the header)
+struct CCheckpointHeader
+{
+    char magic[8];
+    int version, word_size, datapath_w, mem_addr_w, conf_mem_size;
+    int n_stage, n_mem, n_vi, n_vo, n_alu, n_alulite, n_mul, n_muladd, n_bs;
+    uint64_t size;
+};
+
+//header of a checkpoint of this topology, size 0
+CCheckpointHeader checkpoint_header();
+
+class CCheckpoint
+{
+public:
+    std::vector<char> data;
+    size_t pos = 0;
+    bool loading = 0;
+    bool error = 0; //load past the end of data
+
+    template <class T>
+    void io(T &v)
+    {
+        io_raw(&v, sizeof(T));
+    }
+
+    void io_raw(void *p, size_t n)
+    {
+        if (!loading)
+            data.insert(data.end(), (char *)p, (char *)p + n);
+        else if (pos + n > data.size())
+            error = 1;
+        else
+        {
+            memcpy(p, &data[pos], n);
+            pos += n;
+        }
+    }
+};
+VERSAT_NS_END
+#endif
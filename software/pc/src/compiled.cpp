@@ -0,0 +1,404 @@
+#include "versat.hpp"
+#include <algorithm>
+
+VERSAT_NS_BEGIN
+
+//
+// step functions
+//
+
+//CMemPort::output() of a port past its delay, with the direction fixed
+//and the written data at a
+template <bool IN_WR>
+bool CCompiledRun::mem_output(const CCompiledStep &step)
+{
+    CMemPort *p = (CMemPort *)step.unit;
+    if (p->done)
+        return 0;
+    uint32_t addr = p->next_addr();
+    if (!IN_WR)
+        p->out = p->read(addr);
+    else if (p->enable == 1)
+    {
+        p->write(addr, *step.a);
+        p->out = *step.a;
+    }
+    return 0;
+}
+
+//CMemPort::update() of a port past its delay, on its databus slots,
+//the port leaves the chains once retired
+template <bool COPY>
+bool CCompiledRun::mem_update(const CCompiledStep &step)
+{
+    CMemPort *p = (CMemPort *)step.unit;
+    if (p->done)
+        p->done_cnt++;
+    versat_t data = p->output_port.push(p->out);
+    *step.dst = data;
+    if (COPY)
+        *step.dst2 = data;
+    return p->retired();
+}
+
+#if nVI > 0
+bool CCompiledRun::vi_output(const CCompiledStep &step)
+{
+    ((CVI *)step.unit)->output();
+    return 0;
+}
+
+bool CCompiledRun::vi_update(const CCompiledStep &step)
+{
+    ((CVI *)step.unit)->update();
+    return 0;
+}
+#endif
+
+#if nVO > 0
+bool CCompiledRun::vo_output(const CCompiledStep &step)
+{
+    ((CVO *)step.unit)->output();
+    return 0;
+}
+
+bool CCompiledRun::vo_update(const CCompiledStep &step)
+{
+    ((CVO *)step.unit)->update();
+    return 0;
+}
+#endif
+
+//shift output pipeline, update databus
+template <class FU, bool COPY>
+bool CCompiledRun::fu_update(const CCompiledStep &step)
+{
+    FU *u = (FU *)step.unit;
+    versat_t data = u->output_buff.push(u->out);
+    *step.dst = data;
+    if (COPY)
+        *step.dst2 = data;
+    return 0;
+}
+
+#if nALU > 0
+template <int FNS>
+bool CCompiledRun::alu_output(const CCompiledStep &step)
+{
+    CALU *u = (CALU *)step.unit;
+    u->ina = *step.a;
+    u->inb = *step.b;
+    u->out = alu_op<versat_t>(FNS, u->ina, u->inb);
+    return 0;
+}
+#endif
+
+#if nALULITE > 0
+template <int FNS>
+bool CCompiledRun::alulite_output(const CCompiledStep &step)
+{
+    CALULite *u = (CALULite *)step.unit;
+    u->ina = *step.a;
+    u->inb = *step.b;
+    u->loop = (FNS & ALULITE_SELF_LOOP) ? 1 : 0;
+    u->ina_loop = u->loop ? u->out : u->ina;
+    u->out = alulite_op<versat_t>(FNS, u->ina, u->inb, u->out);
+    return 0;
+}
+#endif
+
+#if nMUL > 0
+template <int FNS>
+bool CCompiledRun::mul_output(const CCompiledStep &step)
+{
+    CMul *u = (CMul *)step.unit;
+    u->opa = *step.a;
+    u->opb = *step.b;
+    u->out = mul_op<versat_t>(FNS, u->opa, u->opb);
+    return 0;
+}
+#endif
+
+#if nBS > 0
+template <int FNS>
+bool CCompiledRun::bs_output(const CCompiledStep &step)
+{
+    CBS *u = (CBS *)step.unit;
+    u->in = bs_op<versat_t>(FNS, *step.a, step.param);
+    u->out = u->in;
+    return 0;
+}
+#endif
+
+#if nMULADD > 0
+template <int FNS>
+bool CCompiledRun::muladd_output(const CCompiledStep &step)
+{
+    CMulAdd *u = (CMulAdd *)step.unit;
+    u->opa = *step.a;
+    u->opb = *step.b;
+    u->cnt_addr = u->acumulator();
+    u->acc_w = (u->cnt_addr == 0) ? 0 : u->acc;
+    u->accumulations += u->cnt_addr != 0;
+    mul_t result_mult = (mul_t)u->opa * u->opb;
+    if (FNS == MULADD_MACC)
+        u->acc = u->acc_w + result_mult;
+    else
+        u->acc = u->acc_w - result_mult;
+    u->out = (versat_t)(u->acc >> u->shift);
+    return 0;
+}
+#endif
+
+//
+// compiler
+//
+
+//chain order: stage, then mem ports in port order (ports sharing a memory
+//access it in that order), then VI/VO, then compute FUs by type and index
+#define COMPILED_KEY(s, type, j) (((s) << 16) | ((type) << 8) | (j))
+#define COMPILED_TYPE(key) (((key) >> 8) & 0xFF)
+
+//cycles run() can skip from cycle: until the next join, or stop, when
+//the chains hold only steady compute FUs (VersatInstance::idle_cycles());
+//0 otherwise
+int CCompiledRun::idle_cycles(int cycle, int stop, size_t next)
+{
+    if (next == schedule.size())
+        return 0;
+    for (size_t i = 0; i < output_chain.size(); i++)
+    {
+        void *u = output_chain[i].unit;
+        switch (COMPILED_TYPE(output_key[i]))
+        {
+        //mem ports in the chains are not retired, VI/VO run every cycle
+        case 0:
+            return 0;
+#if nALU > 0
+        case 1:
+            if (!((CALU *)u)->steady())
+                return 0;
+            break;
+#endif
+#if nALULITE > 0
+        case 2:
+            if (!((CALULite *)u)->steady())
+                return 0;
+            break;
+#endif
+#if nMUL > 0
+        case 3:
+            if (!((CMul *)u)->steady())
+                return 0;
+            break;
+#endif
+#if nBS > 0
+        case 5:
+            if (!((CBS *)u)->steady())
+                return 0;
+            break;
+#endif
+        default:
+            return 0;
+        }
+    }
+    int idle = schedule[next].cycle - cycle;
+    if (stop >= 0 && idle > stop - cycle)
+        idle = stop - cycle;
+    return idle > 0 ? idle : 0;
+}
+
+//schedule a step, units without delay are in the chains from the start
+void CCompiledRun::add(int cycle, int key, CCompiledStep output, CCompiledStep update)
+{
+    if (cycle > 0)
+        schedule.push_back({cycle, key, output, update});
+    else
+        join({0, key, output, update});
+}
+
+//insert a scheduled step in the chains, in key order, the unit is woken
+//from its start delay
+void CCompiledRun::join(const CScheduledStep &s)
+{
+    if (COMPILED_TYPE(s.key) == 0 && (s.key & 0xFF) < 2 * nMEM)
+        ((CMemPort *)s.output.unit)->wake();
+#if nMULADD > 0
+    else if (s.cycle > 0)
+        ((CMulAdd *)s.output.unit)->wake();
+#endif
+    size_t i = std::upper_bound(output_key.begin(), output_key.end(), s.key) - output_key.begin();
+    output_key.insert(output_key.begin() + i, s.key);
+    output_chain.insert(output_chain.begin() + i, s.output);
+    update_chain.insert(update_chain.begin() + i, s.update);
+}
+
+//remove step i of the chains
+void CCompiledRun::leave(size_t i)
+{
+    output_key.erase(output_key.begin() + i);
+    output_chain.erase(output_chain.begin() + i);
+    update_chain.erase(update_chain.begin() + i);
+}
+
+void CCompiledRun::compile(VersatInstance *versat)
+{
+    int s, j;
+
+    this->versat = versat;
+    schedule.clear();
+    output_key.clear();
+    output_chain.clear();
+    update_chain.clear();
+
+    for (s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = versat->shadow_reg[s];
+        versat_t *databus = st.databus;
+        //stage 0 writes a 2nd copy at the end of global databus
+        versat_t *copy = s == 0 ? &versat->global_databus[versat->ring_copy] : NULL;
+        CCompiledStep out, upd;
+
+        for (j = 0; j < 2 * nMEM; j++)
+        {
+            CMemPort &port = st.mem_port(j);
+            int slot = port.out_sel[port.mem_base];
+            out = {port.in_wr == 1 ? mem_output<true> : mem_output<false>, &port, databus + port.sel, NULL,
+                   NULL, NULL, 0};
+            upd = {copy ? mem_update<true> : mem_update<false>, &port, NULL, NULL,
+                   databus + slot, copy ? copy + slot : NULL, 0};
+            add(port.delay, COMPILED_KEY(s, 0, j), out, upd);
+        }
+#if nVI > 0
+        //VI/VO count their own port delay, their external side starts at once
+        for (j = 0; j < nVI; j++)
+        {
+            out = {vi_output, &st.vi[j], NULL, NULL, NULL, NULL, 0};
+            upd = {vi_update, &st.vi[j], NULL, NULL, NULL, NULL, 0};
+            add(0, COMPILED_KEY(s, 0, 2 * nMEM + j), out, upd);
+        }
+#endif
+#if nVO > 0
+        for (j = 0; j < nVO; j++)
+        {
+            out = {vo_output, &st.vo[j], NULL, NULL, NULL, NULL, 0};
+            upd = {vo_update, &st.vo[j], NULL, NULL, NULL, NULL, 0};
+            add(0, COMPILED_KEY(s, 0, 2 * nMEM + nVI + j), out, upd);
+        }
+#endif
+#if nALU > 0
+        static bool (*const alu_fn[16])(const CCompiledStep &) = {
+            alu_output<0>, alu_output<1>, alu_output<2>, alu_output<3>,
+            alu_output<4>, alu_output<5>, alu_output<6>, alu_output<7>,
+            alu_output<8>, alu_output<9>, alu_output<10>, alu_output<11>,
+            alu_output<12>, alu_output<13>, alu_output<14>, alu_output<15>};
+        for (j = 0; j < st.n_active_alu; j++)
+        {
+            CALU &u = st.alu[st.active_alu[j]];
+            int slot = versat->sALU[st.active_alu[j]];
+            out = {alu_fn[u.fns & 0xF], &u, databus + u.opa, databus + u.opb, NULL, NULL, 0};
+            upd = {copy ? fu_update<CALU, true> : fu_update<CALU, false>, &u, NULL, NULL,
+                   databus + slot, copy ? copy + slot : NULL, 0};
+            add(0, COMPILED_KEY(s, 1, st.active_alu[j]), out, upd);
+        }
+#endif
+#if nALULITE > 0
+        static bool (*const alulite_fn[16])(const CCompiledStep &) = {
+            alulite_output<0>, alulite_output<1>, alulite_output<2>, alulite_output<3>,
+            alulite_output<4>, alulite_output<5>, alulite_output<6>, alulite_output<7>,
+            alulite_output<8>, alulite_output<9>, alulite_output<10>, alulite_output<11>,
+            alulite_output<12>, alulite_output<13>, alulite_output<14>, alulite_output<15>};
+        for (j = 0; j < st.n_active_alulite; j++)
+        {
+            CALULite &u = st.alulite[st.active_alulite[j]];
+            int slot = versat->sALULITE[st.active_alulite[j]];
+            out = {alulite_fn[u.fns & 0xF], &u, databus + u.opa, databus + u.opb, NULL, NULL, 0};
+            upd = {copy ? fu_update<CALULite, true> : fu_update<CALULite, false>, &u, NULL, NULL,
+                   databus + slot, copy ? copy + slot : NULL, 0};
+            add(0, COMPILED_KEY(s, 2, st.active_alulite[j]), out, upd);
+        }
+#endif
+#if nMUL > 0
+        for (j = 0; j < st.n_active_mul; j++)
+        {
+            CMul &u = st.mul[st.active_mul[j]];
+            int slot = versat->sMUL[st.active_mul[j]];
+            out = {u.fns == MUL_HI ? mul_output<MUL_HI> : u.fns == MUL_DIV2_HI ? mul_output<MUL_DIV2_HI> : mul_output<MUL_DIV2_LO>,
+                   &u, databus + u.sela, databus + u.selb, NULL, NULL, 0};
+            upd = {copy ? fu_update<CMul, true> : fu_update<CMul, false>, &u, NULL, NULL,
+                   databus + slot, copy ? copy + slot : NULL, 0};
+            add(0, COMPILED_KEY(s, 3, st.active_mul[j]), out, upd);
+        }
+#endif
+#if nMULADD > 0
+        for (j = 0; j < st.n_active_muladd + st.n_wait_muladd; j++)
+        {
+            int k = j < st.n_active_muladd ? st.active_muladd[j] : st.wait_muladd[j - st.n_active_muladd];
+            CMulAdd &u = st.muladd[k];
+            int slot = versat->sMULADD[k];
+            out = {u.fns == MULADD_MACC ? muladd_output<MULADD_MACC> : muladd_output<MULADD_MSUB>,
+                   &u, databus + u.sela, databus + u.selb, NULL, NULL, 0};
+            upd = {copy ? fu_update<CMulAdd, true> : fu_update<CMulAdd, false>, &u, NULL, NULL,
+                   databus + slot, copy ? copy + slot : NULL, 0};
+            add(u.delay, COMPILED_KEY(s, 4, k), out, upd);
+        }
+#endif
+#if nBS > 0
+        for (j = 0; j < st.n_active_bs; j++)
+        {
+            CBS &u = st.bs[st.active_bs[j]];
+            int slot = versat->sBS[st.active_bs[j]];
+            out = {u.fns == BS_SHR_A ? bs_output<BS_SHR_A> : u.fns == BS_SHR_L ? bs_output<BS_SHR_L> : u.fns == BS_SHL ? bs_output<BS_SHL> : bs_output<-1>,
+                   &u, databus + u.data, NULL, NULL, NULL, u.shift};
+            upd = {copy ? fu_update<CBS, true> : fu_update<CBS, false>, &u, NULL, NULL,
+                   databus + slot, copy ? copy + slot : NULL, 0};
+            add(0, COMPILED_KEY(s, 5, st.active_bs[j]), out, upd);
+        }
+#endif
+    }
+    //join() orders the steps joining on a cycle by key
+    std::sort(schedule.begin(), schedule.end(),
+              [](const CScheduledStep &a, const CScheduledStep &b) { return a.cycle < b.cycle; });
+}
+
+int CCompiledRun::run(int cycle, int stop)
+{
+    size_t next = 0;
+    int start = cycle;
+    bool run_mem = 0;
+
+    while (!run_mem && cycle != stop)
+    {
+        //only start delays counting down: jump to the next join
+        int idle = idle_cycles(cycle, stop, next);
+        if (idle > 0)
+        {
+            cycle += idle;
+            if (versat->trace.active())
+                versat->trace.sample(cycle - 1);
+            continue;
+        }
+
+        //units whose start delay ends join the chains
+        for (; next < schedule.size() && schedule[next].cycle <= cycle; next++)
+            join(schedule[next]);
+
+        //calculate new outputs
+        for (const CCompiledStep &step : output_chain)
+            step.fn(step);
+
+        //update output buffers and datapath
+        for (size_t i = 0; i < update_chain.size(); i++)
+            if (update_chain[i].fn(update_chain[i]))
+                leave(i--);
+
+        run_mem = 1;
+        for (int s = 0; s < nSTAGE; s++)
+            run_mem = run_mem && versat->shadow_reg[s].done();
+        if (versat->trace.active())
+            versat->trace.sample(cycle);
+        cycle++;
+    }
+    return cycle - start;
+}
+VERSAT_NS_END
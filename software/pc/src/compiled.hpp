@@ -0,0 +1,85 @@
+#ifndef VERSAT_COMPILED_HPP
+#define VERSAT_COMPILED_HPP
+#include "type.hpp"
+#include <vector>
+
+VERSAT_NS_BEGIN
+
+//
+// Compiled configuration engine
+// The configuration of a run is fixed once it is in shadow_reg, so it is
+// compiled into two chains of steps (outputs, then updates) executed
+// every cycle. Each step is a function specialized for its FU type and
+// function (no fns switch) or mem port direction, bound to its FU object
+// and to constant databus pointers (no selector lookups). Units with a start delay join
+// the chains on the cycle their delay ends, so the steps need no delay
+// checks. Only the live FUs of the stage active lists are compiled, and
+// mem ports leave the chains once done with a drained output pipeline,
+// as they leave the stage active lists.
+//
+
+struct CCompiledStep
+{
+    bool (*fn)(const CCompiledStep &step); //true: the unit leaves the chains (updates)
+    void *unit;
+    const versat_t *a, *b; //operands, a: data written by a mem port
+    versat_t *dst, *dst2;  //databus slots written, dst2 NULL if none
+    int param;             //BS shift
+};
+
+class CCompiledRun
+{
+public:
+    //compile the configuration in versat->shadow_reg, after start_run()
+    void compile(VersatInstance *versat);
+
+    //simulate from run cycle cycle until all mem ports and VI/VO are done
+    //or run cycle stop (-1: none), return the number of cycles simulated
+    int run(int cycle, int stop);
+
+private:
+    VersatInstance *versat = NULL;
+
+    //step joining the chains at a given cycle, key orders the chains
+    struct CScheduledStep
+    {
+        int cycle, key;
+        CCompiledStep output, update;
+    };
+    std::vector<CScheduledStep> schedule; //sorted by cycle
+    std::vector<int> output_key;
+    std::vector<CCompiledStep> output_chain, update_chain;
+
+    void add(int cycle, int key, CCompiledStep output, CCompiledStep update);
+    void join(const CScheduledStep &s);
+    void leave(size_t i);
+    int idle_cycles(int cycle, int stop, size_t next);
+
+    //step functions
+    template <bool IN_WR>
+    static bool mem_output(const CCompiledStep &step);
+    template <bool COPY>
+    static bool mem_update(const CCompiledStep &step);
+#if nVI > 0
+    static bool vi_output(const CCompiledStep &step);
+    static bool vi_update(const CCompiledStep &step);
+#endif
+#if nVO > 0
+    static bool vo_output(const CCompiledStep &step);
+    static bool vo_update(const CCompiledStep &step);
+#endif
+    template <int FNS>
+    static bool alu_output(const CCompiledStep &step);
+    template <int FNS>
+    static bool alulite_output(const CCompiledStep &step);
+    template <int FNS>
+    static bool mul_output(const CCompiledStep &step);
+    template <int FNS>
+    static bool bs_output(const CCompiledStep &step);
+    template <int FNS>
+    static bool muladd_output(const CCompiledStep &step);
+    template <class FU, bool COPY>
+    static bool fu_update(const CCompiledStep &step);
+};
+VERSAT_NS_END
+#endif
@@ -0,0 +1,335 @@
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
+
+//fields of the register map: width in the configuration register, sign
+//extension and offset in CStage
+struct CConfLayout
+{
+    int width[CONF_REG_FIELDS];
+    bool sign[CONF_REG_FIELDS];
+    ptrdiff_t offset[CONF_REG_FIELDS];
+};
+
+static void field(CConfLayout &l, int a, int width, bool sign = 0)
+{
+    l.width[a] = width;
+    l.sign[a] = sign;
+}
+
+//widths of the register writes of xconf_reg.v
+static CConfLayout make_layout()
+{
+    CConfLayout l;
+    memset(&l, 0, sizeof(l));
+    int i, b;
+    for (i = 0; i < 2 * nMEM; i++)
+    {
+        b = CONF_MEM0A + i * MEMP_CONF_OFFSET;
+        field(l, b + MEMP_CONF_ITER, MEM_ADDR_W);
+        field(l, b + MEMP_CONF_PER, PERIOD_W);
+        field(l, b + MEMP_CONF_DUTY, PERIOD_W);
+        field(l, b + MEMP_CONF_SEL, N_W);
+        field(l, b + MEMP_CONF_START, MEM_ADDR_W);
+        field(l, b + MEMP_CONF_SHIFT, MEM_ADDR_W, 1);
+        field(l, b + MEMP_CONF_INCR, MEM_ADDR_W, 1);
+        field(l, b + MEMP_CONF_DELAY, PERIOD_W);
+        field(l, b + MEMP_CONF_RVRS, 1);
+        field(l, b + MEMP_CONF_EXT, 1);
+        field(l, b + MEMP_CONF_IN_WR, 1);
+        field(l, b + MEMP_CONF_ITER2, MEM_ADDR_W);
+        field(l, b + MEMP_CONF_PER2, PERIOD_W);
+        field(l, b + MEMP_CONF_SHIFT2, MEM_ADDR_W, 1);
+        field(l, b + MEMP_CONF_INCR2, MEM_ADDR_W, 1);
+    }
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+    {
+        b = CONF_VI0 + i * VI_CONF_OFFSET;
+        field(l, b + VI_CONF_EXT_ADDR, IO_ADDR_W);
+        field(l, b + VI_CONF_INT_ADDR, MEM_ADDR_W);
+        field(l, b + VI_CONF_SIZE, IO_SIZE_W);
+        field(l, b + VI_CONF_ITER_A, MEM_ADDR_W);
+        field(l, b + VI_CONF_PER_A, PERIOD_W);
+        field(l, b + VI_CONF_DUTY_A, PERIOD_W);
+        field(l, b + VI_CONF_SHIFT_A, MEM_ADDR_W, 1);
+        field(l, b + VI_CONF_INCR_A, MEM_ADDR_W, 1);
+        field(l, b + VI_CONF_ITER_B, MEM_ADDR_W);
+        field(l, b + VI_CONF_PER_B, PERIOD_W);
+        field(l, b + VI_CONF_DUTY_B, PERIOD_W);
+        field(l, b + VI_CONF_START_B, MEM_ADDR_W);
+        field(l, b + VI_CONF_SHIFT_B, MEM_ADDR_W, 1);
+        field(l, b + VI_CONF_INCR_B, MEM_ADDR_W, 1);
+        field(l, b + VI_CONF_DELAY_B, PERIOD_W);
+        field(l, b + VI_CONF_RVRS_B, 1);
+        field(l, b + VI_CONF_EXT_B, 1);
+        field(l, b + VI_CONF_ITER2_B, MEM_ADDR_W);
+        field(l, b + VI_CONF_PER2_B, PERIOD_W);
+        field(l, b + VI_CONF_SHIFT2_B, MEM_ADDR_W, 1);
+        field(l, b + VI_CONF_INCR2_B, MEM_ADDR_W, 1);
+    }
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+    {
+        b = CONF_VO0 + i * VO_CONF_OFFSET;
+        field(l, b + VO_CONF_EXT_ADDR, IO_ADDR_W);
+        field(l, b + VO_CONF_INT_ADDR, MEM_ADDR_W);
+        field(l, b + VO_CONF_SIZE, IO_SIZE_W);
+        field(l, b + VO_CONF_ITER_A, MEM_ADDR_W);
+        field(l, b + VO_CONF_PER_A, PERIOD_W);
+        field(l, b + VO_CONF_DUTY_A, PERIOD_W);
+        field(l, b + VO_CONF_SHIFT_A, MEM_ADDR_W, 1);
+        field(l, b + VO_CONF_INCR_A, MEM_ADDR_W, 1);
+        field(l, b + VO_CONF_ITER_B, MEM_ADDR_W);
+        field(l, b + VO_CONF_PER_B, PERIOD_W);
+        field(l, b + VO_CONF_DUTY_B, PERIOD_W);
+        field(l, b + VO_CONF_SEL_B, N_W);
+        field(l, b + VO_CONF_START_B, MEM_ADDR_W);
+        field(l, b + VO_CONF_SHIFT_B, MEM_ADDR_W, 1);
+        field(l, b + VO_CONF_INCR_B, MEM_ADDR_W, 1);
+        field(l, b + VO_CONF_DELAY_B, PERIOD_W);
+        field(l, b + VO_CONF_RVRS_B, 1);
+        field(l, b + VO_CONF_EXT_B, 1);
+        field(l, b + VO_CONF_ITER2_B, MEM_ADDR_W);
+        field(l, b + VO_CONF_PER2_B, PERIOD_W);
+        field(l, b + VO_CONF_SHIFT2_B, MEM_ADDR_W, 1);
+        field(l, b + VO_CONF_INCR2_B, MEM_ADDR_W, 1);
+    }
+#endif
+#if nALU > 0
+    for (i = 0; i < nALU; i++)
+    {
+        b = CONF_ALU0 + i * ALU_CONF_OFFSET;
+        field(l, b + ALU_CONF_SELA, N_W);
+        field(l, b + ALU_CONF_SELB, N_W);
+        field(l, b + ALU_CONF_FNS, ALU_FNS_W);
+    }
+#endif
+#if nALULITE > 0
+    for (i = 0; i < nALULITE; i++)
+    {
+        b = CONF_ALULITE0 + i * ALULITE_CONF_OFFSET;
+        field(l, b + ALULITE_CONF_SELA, N_W);
+        field(l, b + ALULITE_CONF_SELB, N_W);
+        field(l, b + ALULITE_CONF_FNS, ALULITE_FNS_W);
+    }
+#endif
+#if nMUL > 0
+    for (i = 0; i < nMUL; i++)
+    {
+        b = CONF_MUL0 + i * MUL_CONF_OFFSET;
+        field(l, b + MUL_CONF_SELA, N_W);
+        field(l, b + MUL_CONF_SELB, N_W);
+        field(l, b + MUL_CONF_FNS, MUL_FNS_W);
+    }
+#endif
+#if nMULADD > 0
+    for (i = 0; i < nMULADD; i++)
+    {
+        b = CONF_MULADD0 + i * MULADD_CONF_OFFSET;
+        field(l, b + MULADD_CONF_SELA, N_W);
+        field(l, b + MULADD_CONF_SELB, N_W);
+        field(l, b + MULADD_CONF_FNS, MULADD_FNS_W);
+        field(l, b + MULADD_CONF_ITER, MEM_ADDR_W);
+        field(l, b + MULADD_CONF_PER, PERIOD_W);
+        field(l, b + MULADD_CONF_DELAY, PERIOD_W);
+        field(l, b + MULADD_CONF_SHIFT, SHIFT_W);
+    }
+#endif
+#if nBS > 0
+    for (i = 0; i < nBS; i++)
+    {
+        b = CONF_BS0 + i * BS_CONF_OFFSET;
+        field(l, b + BS_CONF_SELD, N_W);
+        field(l, b + BS_CONF_SELS, N_W);
+        field(l, b + BS_CONF_FNS, BS_FNS_W);
+    }
+#endif
+
+    //the same fields in any CStage
+    CStage st;
+    for (int a = 0; a < CONF_REG_FIELDS; a++)
+    {
+        int *f = st.conf_field(a);
+        l.offset[a] = f ? (char *)f - (char *)&st : -1;
+    }
+    return l;
+}
+
+static const CConfLayout &layout()
+{
+    static const CConfLayout l = make_layout();
+    return l;
+}
+
+int conf_field_width(int a)
+{
+    return a >= 0 && a < CONF_REG_FIELDS ? layout().width[a] : 0;
+}
+
+ptrdiff_t conf_field_offset(int a)
+{
+    return a >= 0 && a < CONF_REG_FIELDS ? layout().offset[a] : -1;
+}
+
+int conf_words()
+{
+    return (CONF_BITS + 31) / 32;
+}
+
+void pack_conf(const CStageConf &c, uint32_t *bits)
+{
+    const CConfLayout &l = layout();
+    memset(bits, 0, conf_words() * sizeof(uint32_t));
+    //fields from the MSB down, a field spans at most two words
+    int pos = CONF_BITS;
+    for (int a = 0; a < CONF_REG_FIELDS; a++)
+    {
+        int w = l.width[a];
+        if (!w)
+            continue;
+        pos -= w;
+        uint64_t mask = (1ULL << w) - 1;
+        uint64_t v = ((uint64_t)(uint32_t)c.field[a] & mask) << (pos % 32);
+        bits[pos / 32] |= (uint32_t)v;
+        if (pos % 32 + w > 32)
+            bits[pos / 32 + 1] |= (uint32_t)(v >> 32);
+    }
+}
+
+void unpack_conf(const uint32_t *bits, CStageConf &c)
+{
+    const CConfLayout &l = layout();
+    int pos = CONF_BITS;
+    for (int a = 0; a < CONF_REG_FIELDS; a++)
+    {
+        int w = l.width[a];
+        if (!w)
+        {
+            c.field[a] = 0;
+            continue;
+        }
+        pos -= w;
+        uint64_t v = bits[pos / 32];
+        if (pos % 32 + w > 32)
+            v |= (uint64_t)bits[pos / 32 + 1] << 32;
+        uint64_t mask = (1ULL << w) - 1;
+        v = (v >> (pos % 32)) & mask;
+        if (l.sign[a] && (v >> (w - 1)) & 1)
+            v |= ~mask;
+        c.field[a] = (int)(uint32_t)v;
+    }
+}
+
+CConfImageHeader conf_image_header()
+{
+    CConfImageHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CONF_IMAGE_MAGIC, sizeof(h.magic));
+    h.version = CONF_IMAGE_VERSION;
+    h.conf_bits = CONF_BITS;
+    h.conf_words = conf_words();
+    h.n_stage = nSTAGE;
+    return h;
+}
+
+void CStage::get_conf(CStageConf &c)
+{
+    const CConfLayout &l = layout();
+    for (int a = 0; a < CONF_REG_FIELDS; a++)
+        c.field[a] = l.offset[a] < 0 ? 0 : *(int *)((char *)this + l.offset[a]);
+}
+
+void CStage::set_conf(const CStageConf &c)
+{
+    const CConfLayout &l = layout();
+    for (int a = 0; a < CONF_REG_FIELDS; a++)
+        if (l.offset[a] >= 0)
+            *(int *)((char *)this + l.offset[a]) = c.field[a];
+}
+
+//all stages
+void VersatInstance::get_conf(CStageConf *c)
+{
+    for (int i = 0; i < nSTAGE; i++)
+        stage[i].get_conf(c[i]);
+}
+
+void VersatInstance::set_conf(const CStageConf *c)
+{
+    for (int i = 0; i < nSTAGE; i++)
+        stage[i].set_conf(c[i]);
+}
+
+std::vector<uint32_t> VersatInstance::conf_bits()
+{
+    int n = conf_words();
+    std::vector<uint32_t> bits((size_t)nSTAGE * n);
+    CStageConf c;
+    for (int i = 0; i < nSTAGE; i++)
+    {
+        stage[i].get_conf(c);
+        pack_conf(c, &bits[(size_t)i * n]);
+    }
+    return bits;
+}
+
+int VersatInstance::set_conf_bits(const uint32_t *bits, size_t words)
+{
+    int n = conf_words();
+    if (words != (size_t)nSTAGE * n)
+    {
+        printf("Invalid configuration size %zu words, %d expected\n", words, nSTAGE * n);
+        return -1;
+    }
+    CStageConf c;
+    for (int i = 0; i < nSTAGE; i++)
+    {
+        unpack_conf(&bits[(size_t)i * n], c);
+        stage[i].set_conf(c);
+    }
+    return 0;
+}
+
+int VersatInstance::save_conf(const char *path)
+{
+    CConfImageHeader h = conf_image_header();
+    std::vector<uint32_t> bits = conf_bits();
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(bits.data(), sizeof(uint32_t), bits.size(), f) == bits.size();
+    fclose(f);
+    if (!ok)
+    {
+        printf("Cannot write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int VersatInstance::load_conf(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    CConfImageHeader h = conf_image_header(), fh;
+    std::vector<uint32_t> bits((size_t)nSTAGE * conf_words());
+    bool ok = fread(&fh, sizeof(fh), 1, f) == 1 && memcmp(&fh, &h, sizeof(h)) == 0 &&
+              fread(bits.data(), sizeof(uint32_t), bits.size(), f) == bits.size() && fgetc(f) == EOF;
+    fclose(f);
+    if (!ok)
+    {
+        printf("Configuration image %s does not match this Versat\n", path);
+        return -1;
+    }
+    return set_conf_bits(bits.data(), bits.size());
+}
+VERSAT_NS_END
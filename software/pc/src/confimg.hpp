@@ -0,0 +1,55 @@
+#ifndef VERSAT_CONFIMG_HPP
+#define VERSAT_CONFIMG_HPP
+#include "type.hpp"
+#include <stddef.h>
+
+VERSAT_NS_BEGIN
+
+//
+// Configuration image
+// The configuration register of a stage (xconf_reg.v) is CONF_BITS wide:
+// the fields of the register map (xconfdefs.vh), in address order, each
+// with its width in the register (MEM_ADDR_W, PERIOD_W, N_W ...), packed
+// from bit CONF_BITS-1 down. A packed stage holds that vector in
+// conf_words() 32 bit words, bit i in bit i % 32 of word i / 32, so it is
+// written to the hardware or a conf_mem entry as is. Packing truncates
+// the fields to their widths as the register writes do; the address
+// increments and shifts are sign extended when unpacked.
+// CStageConf is the unpacked form: the value of each register address,
+// copied to and from a CStage through a table of field offsets.
+//
+#define CONF_IMAGE_MAGIC "VERSATCF"
+#define CONF_IMAGE_VERSION 1
+
+//configuration of a stage as the firmware writes it: field[a] is the
+//value of register a of the stage map, 0 for addresses without a field
+struct CStageConf
+{
+    int field[CONF_REG_FIELDS];
+};
+
+//width of field a in the configuration register, 0 if a has none
+int conf_field_width(int a);
+
+//32 bit words of a packed stage
+int conf_words();
+
+//c to/from conf_words() words at bits
+void pack_conf(const CStageConf &c, uint32_t *bits);
+void unpack_conf(const uint32_t *bits, CStageConf &c);
+
+//offset of field a in CStage, -1 if a has none (CStage::get_conf())
+ptrdiff_t conf_field_offset(int a);
+
+//header of a file of nSTAGE packed stages, stage 0 first
+struct CConfImageHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t conf_bits, conf_words, n_stage;
+};
+
+//header of an image of this topology
+CConfImageHeader conf_image_header();
+VERSAT_NS_END
+#endif
@@ -0,0 +1,56 @@
+#ifndef VERSAT_DELAY_LINE_HPP
+#define VERSAT_DELAY_LINE_HPP
+#include "type.hpp"
+#include "checkpoint.hpp"
+
+VERSAT_NS_BEGIN
+
+//
+// FU output latency: ring buffer holding the last LAT outputs.
+// A value pushed in the update of cycle c is returned by the push of
+// cycle c+LAT-1, so it is on the databus for the outputs of cycle c+LAT.
+// Each push costs O(1) whatever the latency.
+//
+template <int LAT, typename T = versat_t>
+class CDelayLine
+{
+private:
+    T buff[LAT] = {0};
+    int head = 0; //oldest value, next to be overwritten
+
+public:
+    //insert new value, return the one leaving the pipeline
+    T push(T in)
+    {
+        buff[head] = in;
+        if (++head == LAT)
+            head = 0;
+        return buff[head];
+    }
+
+    //value pushed k updates ago (0 = newest)
+    T operator[](int k) const
+    {
+        int i = head - 1 - k;
+        return buff[i < 0 ? i + LAT : i];
+    }
+
+    int size() const { return LAT; }
+
+    //every value in the pipeline is v
+    bool uniform(T v) const
+    {
+        for (int i = 0; i < LAT; i++)
+            if (buff[i] != v)
+                return false;
+        return true;
+    }
+
+    void state(CCheckpoint &c)
+    {
+        c.io(buff);
+        c.io(head);
+    }
+};
+VERSAT_NS_END
+#endif
@@ -0,0 +1,114 @@
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
+#if nVI > 0 || nVO > 0
+
+CExtAddrGen::CExtAddrGen()
+{
+}
+
+CExtAddrGen::CExtAddrGen(VersatInstance *versat, CMem *mem, int direction)
+{
+    this->versat = versat;
+    this->my_mem = mem;
+    this->direction = direction;
+}
+
+void CExtAddrGen::start_run()
+{
+    counter = 0;
+    pending = 0;
+    addr = 0;
+    done = versat->ext_mem == NULL;
+
+    agu.iter = iter;
+    agu.per = per;
+    agu.duty = duty;
+    agu.shift = shift;
+    agu.incr = incr;
+    agu.start = 0;
+    agu.delay = 0;
+    agu.iter2 = agu.per2 = 0;
+    agu.start_run();
+}
+
+void CExtAddrGen::output()
+{
+    if (done)
+        return;
+
+    //complete the transfer issued the last cycle
+    if (pending)
+    {
+        if (direction == EXT2INT)
+            my_mem->write(pending_int, pending_data);
+        else
+            versat->ext_write(pending_ext, pending_data);
+        pending = 0;
+    }
+    if (counter > size)
+    {
+        done = 1;
+        return;
+    }
+
+    //issue the next one, the address pattern holds its last address when done
+    if (!agu.done)
+        addr = agu.AGU();
+    pending_ext = ext_addr + addr;
+    pending_int = (int_addr + counter) & (versat->mem_size() - 1);
+    if (direction == EXT2INT)
+        pending_data = versat->ext_read(pending_ext);
+    else
+        pending_data = my_mem->read(pending_int);
+    pending = 1;
+    counter++;
+}
+
+void CExtAddrGen::copy(const CExtAddrGen &that)
+{
+    this->ext_addr = that.ext_addr;
+    this->int_addr = that.int_addr;
+    this->size = that.size;
+    this->iter = that.iter;
+    this->per = that.per;
+    this->duty = that.duty;
+    this->shift = that.shift;
+    this->incr = that.incr;
+}
+
+void CExtAddrGen::state(CCheckpoint &c)
+{
+    c.io(direction);
+    c.io(ext_addr);
+    c.io(int_addr);
+    c.io(size);
+    c.io(iter);
+    c.io(per);
+    c.io(duty);
+    c.io(shift);
+    c.io(incr);
+    c.io(done);
+    c.io(addr);
+    c.io(counter);
+    c.io(pending);
+    c.io(pending_ext);
+    c.io(pending_int);
+    c.io(pending_data);
+    agu.state(c);
+}
+
+string CExtAddrGen::info()
+{
+    string ver = "ExtAddr=  " + to_string(ext_addr) + "\n";
+    ver += "IntAddr=  " + to_string(int_addr) + "\n";
+    ver += "Size=     " + to_string(size) + "\n";
+    ver += "ExtIter=  " + to_string(iter) + "\n";
+    ver += "ExtPer=   " + to_string(per) + "\n";
+    ver += "ExtDuty=  " + to_string(duty) + "\n";
+    ver += "ExtShift= " + to_string(shift) + "\n";
+    ver += "ExtIncr=  " + to_string(incr) + "\n";
+    return ver;
+}
+#endif
+VERSAT_NS_END
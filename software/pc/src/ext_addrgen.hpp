@@ -0,0 +1,60 @@
+#ifndef VERSAT_EXT_ADDRGEN_HPP
+#define VERSAT_EXT_ADDRGEN_HPP
+#include "type.hpp"
+#include "mem.hpp"
+
+VERSAT_NS_BEGIN
+#if nVI > 0 || nVO > 0
+
+//transfer directions (ext_addrgen.v)
+#define EXT2INT 1
+#define INT2EXT 2
+
+//
+// External side of a VI/VO unit (ext_addrgen.v)
+// Each run moves size+1 words, one per cycle, between the host external
+// memory, at ext_addr plus a 2-loop address pattern, and the unit memory
+// from int_addr on. A transfer completes the cycle after it is issued.
+// With no external memory set the external side is idle.
+//
+class CExtAddrGen
+{
+private:
+    CMemPort agu;      //external address pattern, start 0 and no delay
+    uint32_t addr = 0; //last generated address
+    int counter = 0;   //words issued
+    bool pending = 0;  //transfer issued the last cycle
+    uint32_t pending_ext = 0;
+    int pending_int = 0;
+    versat_t pending_data = 0;
+
+public:
+    VersatInstance *versat = NULL;
+    CMem *my_mem = NULL;
+    int direction = EXT2INT;
+    int ext_addr = 0, int_addr = 0, size = 0;
+    int iter = 0, per = 0, duty = 0, shift = 0, incr = 0;
+    bool done = 1;
+
+    //Default constructor
+    CExtAddrGen();
+    CExtAddrGen(VersatInstance *versat, CMem *mem, int direction);
+
+    //start run
+    void start_run();
+
+    //complete the last transfer, issue the next
+    void output();
+
+    //words issued in this run
+    int transfers() { return counter; }
+
+    void copy(const CExtAddrGen &that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
+    string info();
+};
+
+#endif
+VERSAT_NS_END
+#endif
@@ -1,4 +1,6 @@
-#include "mem.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 #if nMEM > 0
 
 versat_t CMem::read(uint32_t addr)
@@ -9,13 +11,75 @@ void CMem::write(uint32_t addr, versat_t data_in)
 {
     data[addr] = data_in;
 }
+
+bool CMem::check_range(const char *op, long addr, long last, int size)
+{
+    if (addr < 0 || addr >= size || last < 0 || last >= size)
+    {
+        printf("Invalid %s MEM BLOCK ADDR=%ld..%ld\n", op, addr, last);
+        return false;
+    }
+    return true;
+}
+
+void CMem::write_block(int addr, const versat_t *src, int n, int size)
+{
+    if (n > 0 && check_range("WRITE", addr, (long)addr + n - 1, size))
+        memcpy(data + addr, src, n * sizeof(versat_t));
+}
+
+void CMem::read_block(int addr, versat_t *dst, int n, int size)
+{
+    if (n > 0 && check_range("READ", addr, (long)addr + n - 1, size))
+        memcpy(dst, data + addr, n * sizeof(versat_t));
+}
+
+void CMem::write_strided(int addr, int stride, const versat_t *src, int n, int size)
+{
+    if (n > 0 && check_range("WRITE", addr, addr + (long)(n - 1) * stride, size))
+        for (int k = 0; k < n; k++)
+            data[addr + k * stride] = src[k];
+}
+
+void CMem::read_strided(int addr, int stride, versat_t *dst, int n, int size)
+{
+    if (n > 0 && check_range("READ", addr, addr + (long)(n - 1) * stride, size))
+        for (int k = 0; k < n; k++)
+            dst[k] = data[addr + k * stride];
+}
+
+void CMem::write_tile(int addr, int ld, const versat_t *src, int src_ld, int rows, int cols, int size)
+{
+    long last_row = addr + (long)(rows - 1) * ld;
+    if (rows > 0 && cols > 0 && check_range("WRITE", addr, (long)addr + cols - 1, size) &&
+        check_range("WRITE", last_row, last_row + cols - 1, size))
+        for (int r = 0; r < rows; r++)
+            memcpy(data + addr + r * ld, src + (long)r * src_ld, cols * sizeof(versat_t));
+}
+
+void CMem::read_tile(int addr, int ld, versat_t *dst, int dst_ld, int rows, int cols, int size)
+{
+    long last_row = addr + (long)(rows - 1) * ld;
+    if (rows > 0 && cols > 0 && check_range("READ", addr, (long)addr + cols - 1, size) &&
+        check_range("READ", last_row, last_row + cols - 1, size))
+        for (int r = 0; r < rows; r++)
+            memcpy(dst + (long)r * dst_ld, data + addr + r * ld, cols * sizeof(versat_t));
+}
 CMemPort::CMemPort() {}
-CMemPort::CMemPort(int versat_base, int i, int offset, versat_t *databus)
+CMemPort::CMemPort(VersatInstance *versat, int versat_base, int i, int offset, versat_t *databus)
+    : CMemPort(versat, versat_base, i, &versat->versat_mem[versat_base][i],
+               offset == 0 ? versat->sMEMA : versat->sMEMB, databus)
+{
+    this->data_base = offset;
+}
+CMemPort::CMemPort(VersatInstance *versat, int versat_base, int i, CMem *mem, int *out_sel, versat_t *databus)
 {
+    this->versat = versat;
     this->versat_base = versat_base;
     this->mem_base = i;
-    this->data_base = offset;
-    this->my_mem = &versat_mem[versat_base][i];
+    this->data_base = 0;
+    this->my_mem = mem;
+    this->out_sel = out_sel;
     this->iter = 0;
     this->per = 0;
     this->duty = 0;
@@ -47,18 +111,19 @@ void CMemPort::reset()
 
 void CMemPort::start_run()
 {
-
+    //the AGU counters start over on every run, as xaddrgen.v on init
+    reset();
     done = 0;
+    done_cnt = 0;
+    steps = enabled_steps = 0;
     pos = start;
     pos2 = start;
     if (duty == 0)
         duty = per;
-    //set run_delay
-    run_delay = delay;
 }
+
 void CMemPort::update()
 {
-    int i = 0;
     //check for delay
     if (run_delay > 0)
     {
@@ -66,37 +131,18 @@ void CMemPort::update()
     }
     else
     {
-        versat_t aux_output = output_port[0];
-        versat_t aux_output2 = 0;
-        //trickle down all outputs in buffer
-        for (i = 1; i < MEMP_LAT; i++)
-        {
-            aux_output2 = output_port[i];
-            output_port[i] = aux_output;
-            aux_output = aux_output2;
-        }
-        //insert new output
-        output_port[0] = out; //TO DO: change according to output()
-
-        //update databus
-        if (data_base == 0)
-        {
-            databus[sMEMA[mem_base]] = output_port[MEMP_LAT - 1];
-            //special case for stage 0
-            if (versat_base == 0)
-            {
-                //2nd copy at the end of global databus
-                global_databus[nSTAGE * (1 << (N_W - 1)) + sMEMA[mem_base]] = output_port[MEMP_LAT - 1];
-            }
-        }
-        else
+        if (done)
+            done_cnt++;
+        //shift output pipeline, update databus
+        versat_t data = output_port.push(out); //TO DO: change according to output()
+        if (out_sel)
         {
-            databus[sMEMB[mem_base]] = output_port[MEMP_LAT - 1];
+            databus[out_sel[mem_base]] = data;
             //special case for stage 0
             if (versat_base == 0)
             {
                 //2nd copy at the end of global databus
-                global_databus[nSTAGE * (1 << (N_W - 1)) + sMEMB[mem_base]] = output_port[MEMP_LAT - 1];
+                versat->global_databus[versat->ring_copy + out_sel[mem_base]] = data;
             }
         }
     }
@@ -211,6 +257,24 @@ uint32_t CMemPort::acumulator()
     return aux;
 }
 
+//AGU step of a running port, counted in the run stats
+uint32_t CMemPort::next_addr()
+{
+    uint32_t addr = AGU();
+    steps++;
+    enabled_steps += enable;
+    //bit reversed address (reverseBits() of xmem.v)
+    if (rvrs)
+    {
+        uint32_t r = 0;
+        int w = versat->topo.mem_addr_w;
+        for (int i = 0; i < w; i++)
+            r |= ((addr >> i) & 1) << (w - 1 - i);
+        addr = r;
+    }
+    return addr;
+}
+
 versat_t CMemPort::output()
 {
     if (run_delay > 0)
@@ -219,7 +283,7 @@ versat_t CMemPort::output()
     int addr = 0;
     if (done == 0)
     {
-        addr = AGU();
+        addr = next_addr();
     }
     else
     {
@@ -332,7 +396,7 @@ void CMemPort::setShift2(int shift2)
 void CMemPort::write(int addr, int val)
 {
     //MEMSET(versat_base, (this->data_base + addr), val);
-    if (addr >= MEM_SIZE)
+    if ((uint32_t)addr >= (uint32_t)versat->mem_size())
     {
         printf("Invalid WRITE MEM ADDR=%u\n", addr);
         printf("VERSAT EXITING ON nStage_%d MEM_%d[%d]\n", versat_base, data_base, mem_base);
@@ -345,7 +409,7 @@ void CMemPort::write(int addr, int val)
 int CMemPort::read(int addr)
 {
     //return MEMGET(versat_base, (this->data_base + addr));
-    if (addr >= MEM_SIZE)
+    if ((uint32_t)addr >= (uint32_t)versat->mem_size())
     {
         printf("Invalid READ MEM ADDR=%u\n", addr);
         printf("VERSAT EXITING ON nStage_%d MEM_%d[%d]\n", versat_base, data_base, mem_base);
@@ -358,6 +422,36 @@ int CMemPort::read(int addr)
     return 0;
 }
 
+void CMemPort::write_block(int addr, const versat_t *src, int n)
+{
+    my_mem->write_block(addr, src, n, versat->mem_size());
+}
+
+void CMemPort::read_block(int addr, versat_t *dst, int n)
+{
+    my_mem->read_block(addr, dst, n, versat->mem_size());
+}
+
+void CMemPort::write_strided(int addr, int stride, const versat_t *src, int n)
+{
+    my_mem->write_strided(addr, stride, src, n, versat->mem_size());
+}
+
+void CMemPort::read_strided(int addr, int stride, versat_t *dst, int n)
+{
+    my_mem->read_strided(addr, stride, dst, n, versat->mem_size());
+}
+
+void CMemPort::write_tile(int addr, int ld, const versat_t *src, int src_ld, int rows, int cols)
+{
+    my_mem->write_tile(addr, ld, src, src_ld, rows, cols, versat->mem_size());
+}
+
+void CMemPort::read_tile(int addr, int ld, versat_t *dst, int dst_ld, int rows, int cols)
+{
+    my_mem->read_tile(addr, ld, dst, dst_ld, rows, cols, versat->mem_size());
+}
+
 void CMemPort::copy(CMemPort that)
 {
     this->versat_base = that.versat_base;
@@ -381,6 +475,56 @@ void CMemPort::copy(CMemPort that)
     this->done = that.done;
 }
 
+void CMemPort::state(CCheckpoint &c)
+{
+    c.io(versat_base);
+    c.io(mem_base);
+    c.io(data_base);
+    c.io(iter);
+    c.io(per);
+    c.io(duty);
+    c.io(sel);
+    c.io(start);
+    c.io(shift);
+    c.io(incr);
+    c.io(delay);
+    c.io(in_wr);
+    c.io(rvrs);
+    c.io(ext);
+    c.io(iter2);
+    c.io(per2);
+    c.io(shift2);
+    c.io(incr2);
+    c.io(done);
+    c.io(run_delay);
+    c.io(out);
+    c.io(enable);
+    c.io(loop1);
+    c.io(loop2);
+    c.io(loop3);
+    c.io(loop4);
+    c.io(pos);
+    c.io(pos2);
+    c.io(aux);
+    c.io(duty_cnt);
+    c.io(done_cnt);
+    c.io(steps);
+    c.io(enabled_steps);
+    output_port.state(c);
+}
+
+void CMemPort::stats(CPortStats &st, int cycles)
+{
+    st.delay_cycles = delay < cycles ? delay : cycles;
+    st.active_cycles = steps;
+    st.enabled_cycles = enabled_steps;
+    st.idle_cycles = steps - enabled_steps;
+    //a read port reads on every step, a write port only when enabled
+    st.reads = in_wr ? 0 : steps;
+    st.writes = in_wr ? enabled_steps : 0;
+    st.done_cycle = done ? delay + steps - 1 : -1;
+}
+
 string CMemPort::info()
 {
     string ver = "mem";
@@ -431,4 +575,5 @@ string CMemPort::info_iter()
 
     return ver;
 }
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
@@ -1,4 +1,10 @@
+#ifndef VERSAT_MEM_HPP
+#define VERSAT_MEM_HPP
 #include "type.hpp"
+#include "delay_line.hpp"
+#include "stats.hpp"
+
+VERSAT_NS_BEGIN
 #if nMEM > 0
 
 class CMem
@@ -8,27 +14,62 @@ private:
     versat_t read(uint32_t addr);
     void write(uint32_t addr, versat_t data_in);
 
+    //[addr, last] inside the first size words, message otherwise
+    bool check_range(const char *op, long addr, long last, int size);
+
 public:
     friend class CMemPort;
+    friend class CExtAddrGen;
+
+    //backing storage, MEM_SIZE words
+    //(CMem is only its data, so versat_mem[nSTAGE][nMEM] is one contiguous
+    //array of nSTAGE * nMEM * MEM_SIZE words, stage major)
+    versat_t *ptr() { return data; }
+    const versat_t *ptr() const { return data; }
+
+    //block copies from/to host buffers, nothing is copied if the block
+    //does not fit in the size words of the memory in the topology
+    //(VersatInstance::mem_size(), the CMemPort copies pass it)
+    //contiguous: mem[addr + k] = src[k]
+    void write_block(int addr, const versat_t *src, int n, int size);
+    void read_block(int addr, versat_t *dst, int n, int size);
+    //strided: mem[addr + k * stride] = src[k]
+    void write_strided(int addr, int stride, const versat_t *src, int n, int size);
+    void read_strided(int addr, int stride, versat_t *dst, int n, int size);
+    //2D tile of rows x cols, row pitch ld in memory and src_ld/dst_ld in the host
+    //mem[addr + r * ld + c] = src[r * src_ld + c]
+    void write_tile(int addr, int ld, const versat_t *src, int src_ld, int rows, int cols, int size);
+    void read_tile(int addr, int ld, versat_t *dst, int dst_ld, int rows, int cols, int size);
 };
+static_assert(sizeof(CMem) == MEM_SIZE * sizeof(versat_t), "CMem must hold only its data");
 
 class CMemPort // 4 Loop AGU
 {
+    friend class CBatchRun;    //lane data path
+    friend class CCompiledRun; //specialized steps
+
 private:
     //count delay during a run():
     int run_delay = 0;
     versat_t out = 0;
     int enable = 0;
-    versat_t output_port[MEMP_LAT] = {0}; //output FIFO
+    CDelayLine<MEMP_LAT> output_port; //output pipeline
     int loop1 = 0, loop2 = 0, loop3 = 0, loop4 = 0;
     uint32_t pos = 0;
     uint32_t pos2 = 0;
     uint32_t aux = 0;
     int duty_cnt = 0;
-
+    //updates since done, the output pipeline is drained after MEMP_LAT
+    int done_cnt = 0;
+    //AGU steps of this run, and those with the enable set
+    int steps = 0, enabled_steps = 0;
 public:
+    VersatInstance *versat = NULL;
     CMem *my_mem;
     int versat_base, mem_base, data_base;
+    //databus selectors of the unit owning the port (sMEMA, sMEMB, sVI),
+    //NULL for ports that do not drive the databus (VO)
+    int *out_sel = NULL;
     int iter, per, duty, sel, start, shift, incr, delay, in_wr /* read or write*/;
     int rvrs = 0 /* reverse addr*/, ext = 0 /* use FU to addr MEM*/, iter2 = 0, per2 = 0, shift2 = 0, incr2 = 0;
     bool done = 0;
@@ -37,14 +78,23 @@ public:
     //Default constructor
     CMemPort();
     //Constructor with an associated base
-    CMemPort(int versat_base, int i, int offset, versat_t *databus);
+    CMemPort(VersatInstance *versat, int versat_base, int i, int offset, versat_t *databus);
+    //Port i of a VI/VO unit, on its own memory
+    CMemPort(VersatInstance *versat, int versat_base, int i, CMem *mem, int *out_sel, versat_t *databus);
     //set MEMPort configuration to shadow register
     //start run
     void start_run();
     //update output buffer, write results to databus
     void update();
+    //end of start delay, skipped while waiting for it
+    void wake() { run_delay = 0; }
+    //done with a drained output pipeline: no further change until the next run
+    bool retired() { return done && done_cnt >= MEMP_LAT; }
 
     versat_t output();
+    //memory address of this cycle of a port that is not done, AGU() with
+    //the step counters and bit reversal of output()
+    uint32_t next_addr();
     uint32_t AGU();
     uint32_t acumulator();
     void setIter(int iter);
@@ -63,16 +113,27 @@ public:
     void setIncr2(int incr);
     void setShift2(int shift2);
     void copy(CMemPort that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
+    //counters of the run, at run cycle cycles (stats.hpp)
+    void stats(CPortStats &st, int cycles);
 
     void write(int addr, int val);
     int read(int addr);
+    //block copies and direct access to the port memory (see CMem)
+    versat_t *ptr() { return my_mem->ptr(); }
+    //(ranges checked against versat->mem_size())
+    void write_block(int addr, const versat_t *src, int n);
+    void read_block(int addr, versat_t *dst, int n);
+    void write_strided(int addr, int stride, const versat_t *src, int n);
+    void read_strided(int addr, int stride, versat_t *dst, int n);
+    void write_tile(int addr, int ld, const versat_t *src, int src_ld, int rows, int cols);
+    void read_tile(int addr, int ld, versat_t *dst, int dst_ld, int rows, int cols);
     void reset();
     string info();
     string info_iter();
 }; //end class CMEM
 
-extern CMem versat_mem[nSTAGE][nMEM];
-extern int sMEMA[nMEM];
-extern int sMEMB[nMEM];
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
+#endif
@@ -0,0 +1,224 @@
+#include "versat.hpp"
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+VERSAT_NS_BEGIN
+
+CMemImageHeader mem_image_header()
+{
+    CMemImageHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MEM_IMAGE_MAGIC, sizeof(h.magic));
+    h.version = MEM_IMAGE_VERSION;
+    h.datapath_w = DATAPATH_W;
+    h.mem_addr_w = MEM_ADDR_W;
+    h.n_stage = nSTAGE;
+    h.n_mem = nMEM;
+    h.n_vi = nVI;
+    h.n_vo = nVO;
+    return h;
+}
+
+size_t mem_image_size()
+{
+    return sizeof(CMemImageHeader) + (size_t)nSTAGE * (nMEM + nVI + nVO) * sizeof(CMem);
+}
+
+//map size bytes of path, created with that size when writing
+//returns NULL on error, unmap with unmap_file()
+static char empty_file;
+static void *map_file(const char *path, size_t &size, bool write)
+{
+    int fd = write ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Cannot open %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (write ? ftruncate(fd, size) != 0 : fstat(fd, &st) != 0)
+    {
+        printf("Cannot size %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    //nothing to map in an empty file
+    if (!write && st.st_size == 0)
+    {
+        close(fd);
+        size = 0;
+        return &empty_file;
+    }
+    if (!write)
+        size = st.st_size;
+    void *p = mmap(NULL, size, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        printf("Cannot map %s\n", path);
+        return NULL;
+    }
+    return p;
+}
+
+static void unmap_file(const void *p, size_t size)
+{
+    if (size)
+        munmap((void *)p, size);
+}
+
+int VersatInstance::save_mem_image(const char *path)
+{
+    //no run may be writing the memories
+    wait();
+    size_t size = mem_image_size();
+    char *p = (char *)map_file(path, size, true);
+    if (!p)
+        return -1;
+    CMemImageHeader h = mem_image_header();
+    memcpy(p, &h, sizeof(h));
+    char *banks = p + sizeof(h);
+    memcpy(banks, versat_mem, sizeof(versat_mem));
+    banks += sizeof(versat_mem);
+#if nVI > 0
+    memcpy(banks, vi_mem, sizeof(vi_mem));
+    banks += sizeof(vi_mem);
+#endif
+#if nVO > 0
+    memcpy(banks, vo_mem, sizeof(vo_mem));
+#endif
+    unmap_file(p, size);
+    return 0;
+}
+
+int VersatInstance::load_mem_image(const char *path)
+{
+    wait();
+    size_t size = 0;
+    const char *p = (const char *)map_file(path, size, false);
+    if (!p)
+        return -1;
+    CMemImageHeader h = mem_image_header();
+    if (size != mem_image_size() || memcmp(p, &h, sizeof(h)) != 0)
+    {
+        printf("Memory image %s does not match this Versat\n", path);
+        unmap_file(p, size);
+        return -1;
+    }
+    const char *banks = p + sizeof(h);
+    memcpy(versat_mem, banks, sizeof(versat_mem));
+    banks += sizeof(versat_mem);
+#if nVI > 0
+    memcpy(vi_mem, banks, sizeof(vi_mem));
+    banks += sizeof(vi_mem);
+#endif
+#if nVO > 0
+    memcpy(vo_mem, banks, sizeof(vo_mem));
+#endif
+    unmap_file(p, size);
+    return 0;
+}
+
+//
+// $readmemh files, one per memory as in the MEM_INIT_FILE of xmem.v
+// (memories of topo, mem_size() words)
+//
+int VersatInstance::save_mem_hex(int s, int m, const char *path)
+{
+    if (s < 0 || s >= topo.n_stage || m < 0 || m >= topo.n_mem)
+    {
+        printf("Invalid memory nStage_%d MEM_%d\n", s, m);
+        return -1;
+    }
+    wait();
+    //DATAPATH_W / 4 hex digits and a newline per word
+    const int digits = DATAPATH_W / 4;
+    size_t size = (size_t)mem_size() * (digits + 1);
+    char *p = (char *)map_file(path, size, true);
+    if (!p)
+        return -1;
+    static const char hex[] = "0123456789abcdef";
+    const versat_t *data = versat_mem[s][m].ptr();
+    char *line = p;
+    for (int i = 0; i < mem_size(); i++)
+    {
+        uint64_t word = (uint64_t)data[i];
+        for (int d = digits - 1; d >= 0; d--, word >>= 4)
+            line[d] = hex[word & 0xF];
+        line[digits] = '\n';
+        line += digits + 1;
+    }
+    unmap_file(p, size);
+    return 0;
+}
+
+int VersatInstance::load_mem_hex(int s, int m, const char *path)
+{
+    if (s < 0 || s >= topo.n_stage || m < 0 || m >= topo.n_mem)
+    {
+        printf("Invalid memory nStage_%d MEM_%d\n", s, m);
+        return -1;
+    }
+    wait();
+    size_t size = 0;
+    const char *p = (const char *)map_file(path, size, false);
+    if (!p)
+        return -1;
+    versat_t *data = versat_mem[s][m].ptr();
+    const char *c = p, *end = p + size;
+    uint32_t addr = 0;
+    int ret = 0;
+    while (c < end)
+    {
+        //skip blanks and comments
+        if (isspace(*c))
+        {
+            c++;
+            continue;
+        }
+        if (c + 1 < end && c[0] == '/' && c[1] == '/')
+        {
+            while (c < end && *c != '\n')
+                c++;
+            continue;
+        }
+        if (c + 1 < end && c[0] == '/' && c[1] == '*')
+        {
+            for (c += 2; c + 1 < end && !(c[0] == '*' && c[1] == '/'); c++)
+                ;
+            c += 2;
+            continue;
+        }
+        //@address or data word
+        bool at = *c == '@';
+        if (at)
+            c++;
+        uint64_t value = 0;
+        const char *start = c;
+        for (; c < end && (isxdigit(*c) || *c == '_'); c++)
+            if (*c != '_')
+                value = (value << 4) | (isdigit(*c) ? *c - '0' : (tolower(*c) - 'a' + 10));
+        if (c == start)
+        {
+            printf("Invalid hex word at offset %ld in %s\n", (long)(c - p), path);
+            ret = -1;
+            break;
+        }
+        if (at)
+            addr = value;
+        else if (addr >= (uint32_t)mem_size())
+        {
+            printf("Invalid WRITE MEM ADDR=%u in %s\n", addr, path);
+            ret = -1;
+            break;
+        }
+        else
+            data[addr++] = (versat_t)value;
+    }
+    unmap_file(p, size);
+    return ret;
+}
+VERSAT_NS_END
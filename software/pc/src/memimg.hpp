@@ -0,0 +1,33 @@
+#ifndef VERSAT_MEMIMG_HPP
+#define VERSAT_MEMIMG_HPP
+#include "type.hpp"
+
+VERSAT_NS_BEGIN
+
+//
+// Memory image
+// All the stage memories in one binary file: a header with the topology,
+// then the raw banks versat_mem[nSTAGE][nMEM], vi_mem[nSTAGE][nVI] and
+// vo_mem[nSTAGE][nVO], MEM_SIZE words each, in host byte order. That is
+// the layout of the banks in VersatInstance, so an image is mmap'ed and
+// copied in one piece each way.
+//
+#define MEM_IMAGE_MAGIC "VERSATMI"
+#define MEM_IMAGE_VERSION 1
+
+struct CMemImageHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t datapath_w, mem_addr_w;
+    uint32_t n_stage, n_mem, n_vi, n_vo;
+    uint32_t reserved;
+};
+
+//header of an image of this topology
+CMemImageHeader mem_image_header();
+
+//bytes of an image of this topology
+size_t mem_image_size();
+VERSAT_NS_END
+#endif
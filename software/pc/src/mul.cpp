@@ -1,4 +1,6 @@
-#include "mul.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 
 #if nMUL > 0
 
@@ -6,8 +8,9 @@ CMul::CMul()
 {
 }
 
-CMul::CMul(int versat_base, int i, versat_t *databus)
+CMul::CMul(VersatInstance *versat, int versat_base, int i, versat_t *databus)
 {
+    this->versat = versat;
     this->versat_base = versat_base;
     this->mul_base = i;
     this->databus = databus;
@@ -20,24 +23,15 @@ void CMul::start_run()
 
 void CMul::update()
 {
-    int i = 0;
-
-    //update databus
-    databus[sMUL[mul_base]] = output_buff[MUL_LAT - 1];
+    //shift output pipeline, update databus
+    versat_t data = output_buff.push(out);
+    databus[versat->sMUL[mul_base]] = data;
     //special case for stage 0
     if (versat_base == 0)
     {
         //2nd copy at the end of global databus
-        global_databus[nSTAGE * (1 << (N_W - 1)) + sMUL[mul_base]] = output_buff[MUL_LAT - 1];
-    }
-
-    //trickle down all outputs in buffer
-    for (i = 1; i < MUL_LAT; i++)
-    {
-        output_buff[i] = output_buff[i - 1];
+        versat->global_databus[versat->ring_copy + versat->sMUL[mul_base]] = data;
     }
-    //insert new output
-    output_buff[0] = out;
 }
 
 versat_t CMul::output()
@@ -46,24 +40,17 @@ versat_t CMul::output()
     opa = databus[sela];
     opb = databus[selb];
 
-    mul_t result_mult = opa * opb;
-    if (fns == MUL_HI)
-    {
-        result_mult = result_mult << 1;
-        out = (versat_t)(result_mult >> (sizeof(versat_t) * 8));
-    }
-    else if (fns == MUL_DIV2_HI)
-    {
-        out = (versat_t)(result_mult >> (sizeof(versat_t) * 8));
-    }
-    else // MUL_LO
-    {
-        out = (versat_t)result_mult;
-    }
+    out = mul_op<versat_t>(fns, opa, opb);
 
     return out;
 }
 
+bool CMul::steady()
+{
+    return opa == databus[sela] && opb == databus[selb] && out == mul_op<versat_t>(fns, opa, opb) &&
+           output_buff.uniform(out) && databus[versat->sMUL[mul_base]] == out;
+}
+
 void CMul::setSelA(int sela)
 {
     this->sela = sela;
@@ -84,6 +71,19 @@ void CMul::copy(CMul that)
     this->selb = that.selb;
     this->fns = that.fns;
 }
+
+void CMul::state(CCheckpoint &c)
+{
+    c.io(versat_base);
+    c.io(mul_base);
+    c.io(sela);
+    c.io(selb);
+    c.io(fns);
+    c.io(opa);
+    c.io(opb);
+    c.io(out);
+    output_buff.state(c);
+}
 string CMul::info()
 {
     string ver = "mul[" + to_string(mul_base) + "]\n";
@@ -106,4 +106,5 @@ string CMul::info_iter()
     return ver;
 }
 
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
@@ -1,21 +1,31 @@
+#ifndef VERSAT_MUL_HPP
+#define VERSAT_MUL_HPP
 #include "type.hpp"
+#include "delay_line.hpp"
+#include "alu_kernels.hpp"
+
+VERSAT_NS_BEGIN
 
 #if nMUL > 0
 class CMul
 {
+    friend class CSoAEngine;   //packs the unit state
+    friend class CCompiledRun; //specialized steps
+
 private:
     versat_t opa = 0, opb = 0;
-    versat_t output_buff[MUL_LAT]; //output FIFO
+    CDelayLine<MUL_LAT> output_buff; //output pipeline
     versat_t out = 0;
     versat_t *databus = NULL;
 
 public:
+    VersatInstance *versat = NULL;
     int versat_base, mul_base;
     int sela = 0, selb = 0, fns = 0;
     //Default constructor
     CMul();
 
-    CMul(int versat_base, int i, versat_t *databus);
+    CMul(VersatInstance *versat, int versat_base, int i, versat_t *databus);
     //set Mul configuration to shadow register
 
     //start run
@@ -25,7 +35,12 @@ public:
     void update();
 
     versat_t output();
+    //output, inputs and pipeline at a fixed point of the current databus:
+    //as long as the databus holds, further cycles change nothing
+    bool steady();
     void copy(CMul that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
     void setSelA(int sela);
     void setSelB(int selb);
     void setFNS(int fns);
@@ -34,6 +49,6 @@ public:
     string info_iter();
 
 }; //end class CMUL
-extern int sMUL[nMUL];
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
+#endif
@@ -1,4 +1,6 @@
-#include "mul_add.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 #if nMULADD > 0
 class CStage;
 
@@ -6,8 +8,9 @@ CMulAdd::CMulAdd()
 {
 }
 
-CMulAdd::CMulAdd(int versat_base, int i, versat_t *databus)
+CMulAdd::CMulAdd(VersatInstance *versat, int versat_base, int i, versat_t *databus)
 {
+    this->versat = versat;
     this->versat_base = versat_base;
     this->muladd_base = i;
     this->databus = databus;
@@ -28,12 +31,12 @@ void CMulAdd::start_run()
     duty_cnt = 0;
     cnt_addr = 0;
     done = 0;
+    accumulations = 0;
 }
 
 //update output buffer, write results to databus
 void CMulAdd::update()
 {
-    int i = 0;
     //check for delay
     if (run_delay > 0)
     {
@@ -41,25 +44,14 @@ void CMulAdd::update()
     }
     else
     {
-        //trickle down all outputs in buffer
-        versat_t aux_output = output_buff[0];
-        versat_t aux_output2 = 0;
-        //trickle down all outputs in buffer
-        for (i = 1; i < MULADD_LAT; i++)
-        {
-            aux_output2 = output_buff[i];
-            output_buff[i] = aux_output;
-            aux_output = aux_output2;
-        }
-        //insert new output
-        output_buff[0] = out;
-        //update databus
-        databus[sMULADD[muladd_base]] = output_buff[MULADD_LAT - 1];
+        //shift output pipeline, update databus
+        versat_t data = output_buff.push(out);
+        databus[versat->sMULADD[muladd_base]] = data;
         //special case for stage 0
         if (versat_base == 0)
         {
             //2nd copy at the end of global databus
-            global_databus[nSTAGE * (1 << (N_W - 1)) + sMULADD[muladd_base]] = output_buff[MULADD_LAT - 1];
+            versat->global_databus[versat->ring_copy + versat->sMULADD[muladd_base]] = data;
         }
     }
 }
@@ -80,9 +72,10 @@ versat_t CMulAdd::output() //implemented as PIPELINED MULADD
 
     //select acc_w value
     acc_w = (cnt_addr == 0) ? 0 : acc;
+    accumulations += cnt_addr != 0;
 
     //perform MAC operation
-    mul_t result_mult = opa * opb;
+    mul_t result_mult = (mul_t)opa * opb;
     if (fns == MULADD_MACC)
     {
         acc = acc_w + result_mult;
@@ -169,6 +162,45 @@ void CMulAdd::copy(CMulAdd that)
     this->shift = that.shift;
 }
 
+void CMulAdd::state(CCheckpoint &c)
+{
+    c.io(versat_base);
+    c.io(muladd_base);
+    c.io(sela);
+    c.io(selb);
+    c.io(fns);
+    c.io(iter);
+    c.io(per);
+    c.io(delay);
+    c.io(shift);
+    c.io(opa);
+    c.io(opb);
+    c.io(out);
+    c.io(acc);
+    c.io(acc_w);
+    c.io(done);
+    c.io(duty);
+    c.io(duty_cnt);
+    c.io(enable);
+    c.io(shift_addr);
+    c.io(incr);
+    c.io(aux);
+    c.io(pos);
+    c.io(loop2);
+    c.io(loop1);
+    c.io(cnt_addr);
+    c.io(run_delay);
+    c.io(accumulations);
+    output_buff.state(c);
+}
+
+void CMulAdd::stats(CFUStats &st, int cycles, bool live)
+{
+    st.delay_cycles = !live ? 0 : delay < cycles ? delay : cycles;
+    st.active_cycles = live ? cycles - st.delay_cycles : 0;
+    st.accumulations = accumulations;
+}
+
 string CMulAdd::info()
 {
     string ver = "mul_add[" + to_string(muladd_base) + "]\n";
@@ -201,4 +233,5 @@ string CMulAdd::info_iter()
     ver += "\n";
     return ver;
 }
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
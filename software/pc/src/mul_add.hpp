@@ -1,8 +1,18 @@
+#ifndef VERSAT_MUL_ADD_HPP
+#define VERSAT_MUL_ADD_HPP
 #include "type.hpp"
+#include "delay_line.hpp"
+#include "stats.hpp"
+
+VERSAT_NS_BEGIN
 
 #if nMULADD > 0
 class CMulAdd
 {
+    friend class CSoAEngine;   //packs the unit state
+    friend class CCompiledRun; //specialized steps
+    friend class CBatchRun;    //lane data path
+
 private:
     //SIM VARIABLES
     versat_t opa = 0, opb = 0, out = 0;
@@ -13,17 +23,20 @@ private:
     int loop2 = 0, loop1 = 0, cnt_addr = 0;
     //count delay during a run():
     int run_delay = 0;
-    versat_t output_buff[MULADD_LAT] = {0}; //output FIFO
+    //results added to the accumulator in this run
+    int accumulations = 0;
+    CDelayLine<MULADD_LAT> output_buff; //output pipeline
     versat_t *databus = NULL;
 
 public:
+    VersatInstance *versat = NULL;
     int versat_base, muladd_base;
     int sela = 0, selb = 0, fns = 0, iter = 0, per = 0, delay = 0, shift = 0;
 
     //Default constructor
     CMulAdd();
 
-    CMulAdd(int versat_base, int i, versat_t *databus);
+    CMulAdd(VersatInstance *versat, int versat_base, int i, versat_t *databus);
 
     //set MulAdd configuration to shadow register
     void update_shadow_reg_MulAdd();
@@ -33,11 +46,17 @@ public:
 
     //update output buffer, write results to databus
     void update();
+    //end of start delay, skipped while waiting for it
+    void wake() { run_delay = 0; }
     versat_t output(); //implemented as PIPELINED MULADD
 
     void writeConf();
     uint32_t acumulator();
     void copy(CMulAdd that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
+    //counters of the run, at run cycle cycles, live if simulated (stats.hpp)
+    void stats(CFUStats &st, int cycles, bool live);
     void setSelA(int sela);
     void setSelB(int selb);
     void setFNS(int fns);
@@ -50,6 +69,6 @@ public:
     string info_iter();
 }; //end class CMULADD
 
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-extern int sMULADD[nMULADD];
-#endif
\ No newline at end of file
+#endif
+VERSAT_NS_END
+#endif
@@ -0,0 +1,521 @@
+#include "versat.hpp"
+#include <algorithm>
+
+VERSAT_NS_BEGIN
+
+//
+// kernels for each instruction set
+//
+#define SOA_ISA "avx2"
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace soa_avx2
+{
+#include "soa_kernels.hpp"
+}
+#pragma GCC pop_options
+#undef SOA_ISA
+
+#define SOA_ISA "sse4.1"
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+namespace soa_sse4
+{
+#include "soa_kernels.hpp"
+}
+#pragma GCC pop_options
+#undef SOA_ISA
+
+#define SOA_ISA "default"
+namespace soa_default
+{
+#include "soa_kernels.hpp"
+}
+#undef SOA_ISA
+
+const CSoAKernels *soa_kernels()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return &soa_avx2::kernels;
+    else if (__builtin_cpu_supports("sse4.1"))
+        return &soa_sse4::kernels;
+    else
+        return &soa_default::kernels;
+}
+
+CSoAEngine::CSoAEngine()
+{
+    kernels = soa_kernels();
+}
+
+//
+// units of one FU type
+//
+void CSoAUnits::clear(int lat)
+{
+    n = 0;
+    this->lat = lat;
+    head = 0;
+    stage.clear();
+    idx.clear();
+    fns.clear();
+    param.clear();
+    sel_a.clear();
+    sel_b.clear();
+    out.clear();
+    pipe.clear();
+    group_kernel.clear();
+    group_start.clear();
+    group_n.clear();
+    dst_unit.clear();
+    dst.clear();
+}
+
+//global databus index of selector sel of stage s
+static int global_sel(VersatInstance *versat, int s, int sel)
+{
+    return versat->databus_block(s) + sel;
+}
+
+//append a unit, units must be added sorted by kernel (fns)
+void CSoAUnits::add(VersatInstance *versat, int stage, int idx, int fns, int param, int sel_a, int sel_b, int slot)
+{
+    this->stage.push_back(stage);
+    this->idx.push_back(idx);
+    this->fns.push_back(fns);
+    this->param.push_back(param);
+    this->sel_a.push_back(global_sel(versat, stage, sel_a));
+    this->sel_b.push_back(global_sel(versat, stage, sel_b));
+    dst_unit.push_back(n);
+    dst.push_back(global_sel(versat, stage, slot));
+    if (stage == 0)
+    {
+        //2nd copy at the end of global databus
+        dst_unit.push_back(n);
+        dst.push_back(versat->ring_copy + slot);
+    }
+    if (n == 0 || group_kernel.back() != fns)
+    {
+        group_kernel.push_back(fns);
+        group_start.push_back(n);
+        group_n.push_back(0);
+    }
+    group_n.back()++;
+    n++;
+}
+
+//size operand and pipeline arrays once all units are added
+void CSoAUnits::alloc()
+{
+    a.assign(n, 0);
+    b.assign(n, 0);
+    out.assign(n, 0);
+    pipe.assign(lat * n, 0);
+    head = 0;
+}
+
+//insert the new outputs in the pipeline, head moves to the oldest
+void CSoAUnits::push()
+{
+    std::copy(out.begin(), out.end(), pipe.begin() + head * n);
+    if (++head == lat)
+        head = 0;
+}
+
+//write the pipeline outputs to the databus
+void CSoAUnits::scatter(versat_t *global_databus)
+{
+    const versat_t *res = &pipe[head * n];
+    for (size_t i = 0; i < dst.size(); i++)
+        global_databus[dst[i]] = res[dst_unit[i]];
+}
+
+//unit kernels follow the function, sort by it keeping the stage order
+struct CSoAUnitRef
+{
+    int kernel, stage, idx;
+    bool operator<(const CSoAUnitRef &that) const { return kernel < that.kernel; }
+};
+
+//pipeline of unit i from an object delay line
+template <int LAT>
+static void load_pipe(CSoAUnits &u, int i, CDelayLine<LAT> &line)
+{
+    //oldest value at head (0)
+    for (int k = 0; k < LAT; k++)
+        u.pipe[(LAT - 1 - k) * u.n + i] = line[k];
+}
+
+//pipeline of unit i back to an object delay line
+template <int LAT>
+static void store_pipe(CSoAUnits &u, int i, int head, CDelayLine<LAT> &line)
+{
+    //push from oldest to newest
+    for (int k = 0; k < LAT; k++)
+        line.push(u.pipe[((head + k) % LAT) * u.n + i]);
+}
+
+void CSoAEngine::load(VersatInstance *versat)
+{
+    this->versat = versat;
+    std::vector<CSoAUnitRef> ref;
+    int s, j, i;
+
+#if nALU > 0
+    ref.clear();
+    for (s = 0; s < nSTAGE; s++)
+        for (j = 0; j < versat->shadow_reg[s].n_active_alu; j++)
+        {
+            int k = versat->shadow_reg[s].active_alu[j];
+            ref.push_back({versat->shadow_reg[s].alu[k].fns & 0xF, s, k});
+        }
+    std::stable_sort(ref.begin(), ref.end());
+    alu.clear(ALU_LAT);
+    for (auto &r : ref)
+    {
+        CALU &o = versat->shadow_reg[r.stage].alu[r.idx];
+        alu.add(versat, r.stage, r.idx, r.kernel, 0, o.opa, o.opb, versat->sALU[r.idx]);
+    }
+    alu.alloc();
+    for (i = 0; i < alu.n; i++)
+    {
+        CALU &o = versat->shadow_reg[alu.stage[i]].alu[alu.idx[i]];
+        alu.out[i] = o.out;
+        load_pipe(alu, i, o.output_buff);
+    }
+#endif
+#if nALULITE > 0
+    ref.clear();
+    for (s = 0; s < nSTAGE; s++)
+        for (j = 0; j < versat->shadow_reg[s].n_active_alulite; j++)
+        {
+            int k = versat->shadow_reg[s].active_alulite[j];
+            ref.push_back({versat->shadow_reg[s].alulite[k].fns & 0xF, s, k});
+        }
+    std::stable_sort(ref.begin(), ref.end());
+    alulite.clear(ALULITE_LAT);
+    for (auto &r : ref)
+    {
+        CALULite &o = versat->shadow_reg[r.stage].alulite[r.idx];
+        alulite.add(versat, r.stage, r.idx, r.kernel, 0, o.opa, o.opb, versat->sALULITE[r.idx]);
+    }
+    alulite.alloc();
+    for (i = 0; i < alulite.n; i++)
+    {
+        CALULite &o = versat->shadow_reg[alulite.stage[i]].alulite[alulite.idx[i]];
+        alulite.out[i] = o.out;
+        load_pipe(alulite, i, o.output_buff);
+    }
+#endif
+#if nMUL > 0
+    ref.clear();
+    for (s = 0; s < nSTAGE; s++)
+        for (j = 0; j < versat->shadow_reg[s].n_active_mul; j++)
+        {
+            int k = versat->shadow_reg[s].active_mul[j];
+            int fns = versat->shadow_reg[s].mul[k].fns;
+            ref.push_back({fns >= 0 && fns < 4 ? fns : 0, s, k});
+        }
+    std::stable_sort(ref.begin(), ref.end());
+    mul.clear(MUL_LAT);
+    for (auto &r : ref)
+    {
+        CMul &o = versat->shadow_reg[r.stage].mul[r.idx];
+        mul.add(versat, r.stage, r.idx, r.kernel, 0, o.sela, o.selb, versat->sMUL[r.idx]);
+    }
+    mul.alloc();
+    for (i = 0; i < mul.n; i++)
+    {
+        CMul &o = versat->shadow_reg[mul.stage[i]].mul[mul.idx[i]];
+        mul.out[i] = o.out;
+        load_pipe(mul, i, o.output_buff);
+    }
+#endif
+#if nBS > 0
+    ref.clear();
+    for (s = 0; s < nSTAGE; s++)
+        for (j = 0; j < versat->shadow_reg[s].n_active_bs; j++)
+        {
+            int k = versat->shadow_reg[s].active_bs[j];
+            int fns = versat->shadow_reg[s].bs[k].fns;
+            ref.push_back({fns >= 0 && fns < 3 ? fns : 3, s, k});
+        }
+    std::stable_sort(ref.begin(), ref.end());
+    bs.clear(BS_LAT);
+    for (auto &r : ref)
+    {
+        CBS &o = versat->shadow_reg[r.stage].bs[r.idx];
+        bs.add(versat, r.stage, r.idx, r.kernel, o.shift, o.data, o.data, versat->sBS[r.idx]);
+    }
+    bs.alloc();
+    for (i = 0; i < bs.n; i++)
+    {
+        CBS &o = versat->shadow_reg[bs.stage[i]].bs[bs.idx[i]];
+        bs.out[i] = o.out;
+        load_pipe(bs, i, o.output_buff);
+    }
+#endif
+#if nMULADD > 0
+    //waiting and active MulAdds, evaluated in stage order
+    muladd.clear(MULADD_LAT);
+    for (s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = versat->shadow_reg[s];
+        for (j = 0; j < st.n_active_muladd + st.n_wait_muladd; j++)
+        {
+            int k = j < st.n_active_muladd ? st.active_muladd[j] : st.wait_muladd[j - st.n_active_muladd];
+            CMulAdd &o = st.muladd[k];
+            muladd.add(versat, s, k, o.fns, 0, o.sela, o.selb, versat->sMULADD[k]);
+        }
+    }
+    muladd.alloc();
+    int n = muladd.n;
+    ma_delay.resize(n);
+    ma_iter.resize(n);
+    ma_per.resize(n);
+    ma_shift.resize(n);
+    ma_done.resize(n);
+    ma_duty.resize(n);
+    ma_duty_cnt.resize(n);
+    ma_enable.resize(n);
+    ma_shift_addr.resize(n);
+    ma_incr.resize(n);
+    ma_aux.resize(n);
+    ma_pos.resize(n);
+    ma_loop1.resize(n);
+    ma_loop2.resize(n);
+    ma_cnt_addr.resize(n);
+    ma_accumulations.resize(n);
+    ma_head.assign(n, 0);
+    ma_acc.resize(n);
+    ma_acc_w.resize(n);
+    for (i = 0; i < n; i++)
+    {
+        CMulAdd &o = versat->shadow_reg[muladd.stage[i]].muladd[muladd.idx[i]];
+        //start_run() was called: a unit still waits its whole delay
+        ma_delay[i] = o.run_delay;
+        ma_iter[i] = o.iter;
+        ma_per[i] = o.per;
+        ma_shift[i] = o.shift;
+        ma_done[i] = o.done;
+        ma_duty[i] = o.duty;
+        ma_duty_cnt[i] = o.duty_cnt;
+        ma_enable[i] = o.enable;
+        ma_shift_addr[i] = o.shift_addr;
+        ma_incr[i] = o.incr;
+        ma_aux[i] = o.aux;
+        ma_pos[i] = o.pos;
+        ma_loop1[i] = o.loop1;
+        ma_loop2[i] = o.loop2;
+        ma_cnt_addr[i] = o.cnt_addr;
+        ma_accumulations[i] = o.accumulations;
+        ma_acc[i] = o.acc;
+        ma_acc_w[i] = o.acc_w;
+        muladd.out[i] = o.out;
+        load_pipe(muladd, i, o.output_buff);
+    }
+#endif
+}
+
+void CSoAEngine::gather(CSoAUnits &u, bool two)
+{
+    kernels->gather(u.n, versat->global_databus, u.sel_a.data(), u.a.data());
+    if (two)
+        kernels->gather(u.n, versat->global_databus, u.sel_b.data(), u.b.data());
+}
+
+void CSoAEngine::eval(CSoAUnits &u, soa_op2_t const *ops)
+{
+    for (size_t g = 0; g < u.group_kernel.size(); g++)
+    {
+        int i = u.group_start[g];
+        ops[u.group_kernel[g]](u.group_n[g], &u.a[i], &u.b[i], &u.out[i]);
+    }
+}
+
+void CSoAEngine::output(int cycle)
+{
+#if nALU > 0
+    gather(alu, true);
+    eval(alu, kernels->alu);
+#endif
+#if nALULITE > 0
+    gather(alulite, true);
+    eval(alulite, kernels->alulite);
+#endif
+#if nMUL > 0
+    gather(mul, true);
+    eval(mul, kernels->mul);
+#endif
+#if nBS > 0
+    gather(bs, false);
+    for (size_t g = 0; g < bs.group_kernel.size(); g++)
+    {
+        int i = bs.group_start[g];
+        kernels->bs[bs.group_kernel[g]](bs.group_n[g], &bs.a[i], &bs.param[i], &bs.out[i]);
+    }
+#endif
+#if nMULADD > 0
+    //CMulAdd::output() on the unit arrays
+    for (int i = 0; i < muladd.n; i++)
+    {
+        if (cycle < ma_delay[i])
+            continue;
+        versat_t opa = versat->global_databus[muladd.sel_a[i]];
+        versat_t opb = versat->global_databus[muladd.sel_b[i]];
+        muladd.a[i] = opa;
+        muladd.b[i] = opb;
+
+        //address generator
+        if (ma_loop2[i] < ma_iter[i])
+        {
+            if (ma_loop1[i] < ma_per[i])
+            {
+                ma_loop1[i]++;
+                ma_enable[i] = 0;
+                if (ma_duty_cnt[i] < ma_duty[i])
+                {
+                    ma_enable[i] = 1;
+                    ma_aux[i] = ma_pos[i];
+                    ma_duty_cnt[i]++;
+                    ma_pos[i] += ma_incr[i];
+                }
+            }
+            if (ma_loop1[i] == ma_per[i])
+            {
+                ma_loop1[i] = 0;
+                ma_duty_cnt[i] = 0;
+                ma_loop2[i]++;
+                ma_pos[i] += ma_shift_addr[i];
+            }
+        }
+        if (ma_loop2[i] == ma_iter[i])
+        {
+            ma_loop2[i] = 0;
+            ma_done[i] = 1;
+        }
+        ma_cnt_addr[i] = ma_aux[i];
+
+        ma_acc_w[i] = ma_cnt_addr[i] == 0 ? 0 : ma_acc[i];
+        ma_accumulations[i] += ma_cnt_addr[i] != 0;
+        mul_t result_mult = (mul_t)opa * opb;
+        if (muladd.fns[i] == MULADD_MACC)
+            ma_acc[i] = ma_acc_w[i] + result_mult;
+        else
+            ma_acc[i] = ma_acc_w[i] - result_mult;
+        muladd.out[i] = (versat_t)(ma_acc[i] >> ma_shift[i]);
+    }
+#endif
+}
+
+void CSoAEngine::update(int cycle)
+{
+#if nALU > 0
+    alu.push();
+    alu.scatter(versat->global_databus);
+#endif
+#if nALULITE > 0
+    alulite.push();
+    alulite.scatter(versat->global_databus);
+#endif
+#if nMUL > 0
+    mul.push();
+    mul.scatter(versat->global_databus);
+#endif
+#if nBS > 0
+    bs.push();
+    bs.scatter(versat->global_databus);
+#endif
+#if nMULADD > 0
+    //MulAdds start at different cycles, each has its own pipeline head
+    int n = muladd.n;
+    for (size_t d = 0; d < muladd.dst.size(); d++)
+    {
+        int i = muladd.dst_unit[d];
+        if (cycle < ma_delay[i])
+            continue;
+        //push once per unit, on its first databus slot
+        if (d == 0 || muladd.dst_unit[d - 1] != i)
+        {
+            muladd.pipe[ma_head[i] * n + i] = muladd.out[i];
+            if (++ma_head[i] == MULADD_LAT)
+                ma_head[i] = 0;
+        }
+        versat->global_databus[muladd.dst[d]] = muladd.pipe[ma_head[i] * n + i];
+    }
+#endif
+}
+
+void CSoAEngine::store(int cycles)
+{
+    int i;
+#if nALU > 0
+    for (i = 0; i < alu.n; i++)
+    {
+        CALU &o = versat->shadow_reg[alu.stage[i]].alu[alu.idx[i]];
+        o.ina = alu.a[i];
+        o.inb = alu.b[i];
+        o.out = alu.out[i];
+        store_pipe(alu, i, alu.head, o.output_buff);
+    }
+#endif
+#if nALULITE > 0
+    for (i = 0; i < alulite.n; i++)
+    {
+        CALULite &o = versat->shadow_reg[alulite.stage[i]].alulite[alulite.idx[i]];
+        o.loop = (o.fns & ALULITE_SELF_LOOP) ? 1 : 0;
+        o.ina = alulite.a[i];
+        o.inb = alulite.b[i];
+        //feedback operand of the last cycle is the previous output
+        o.ina_loop = o.loop ? alulite.pipe[((alulite.head + ALULITE_LAT - 2 + ALULITE_LAT) % ALULITE_LAT) * alulite.n + i] : o.ina;
+        o.out = alulite.out[i];
+        store_pipe(alulite, i, alulite.head, o.output_buff);
+    }
+#endif
+#if nMUL > 0
+    for (i = 0; i < mul.n; i++)
+    {
+        CMul &o = versat->shadow_reg[mul.stage[i]].mul[mul.idx[i]];
+        o.opa = mul.a[i];
+        o.opb = mul.b[i];
+        o.out = mul.out[i];
+        store_pipe(mul, i, mul.head, o.output_buff);
+    }
+#endif
+#if nBS > 0
+    for (i = 0; i < bs.n; i++)
+    {
+        CBS &o = versat->shadow_reg[bs.stage[i]].bs[bs.idx[i]];
+        o.in = bs.out[i];
+        o.out = bs.out[i];
+        store_pipe(bs, i, bs.head, o.output_buff);
+    }
+#endif
+#if nMULADD > 0
+    for (i = 0; i < muladd.n; i++)
+    {
+        CMulAdd &o = versat->shadow_reg[muladd.stage[i]].muladd[muladd.idx[i]];
+        //units still waiting are left as they are, like the object engine
+        if (cycles <= ma_delay[i])
+            continue;
+        o.run_delay = 0;
+        o.opa = muladd.a[i];
+        o.opb = muladd.b[i];
+        o.done = ma_done[i];
+        o.duty_cnt = ma_duty_cnt[i];
+        o.enable = ma_enable[i];
+        o.aux = ma_aux[i];
+        o.pos = ma_pos[i];
+        o.loop1 = ma_loop1[i];
+        o.loop2 = ma_loop2[i];
+        o.cnt_addr = ma_cnt_addr[i];
+        o.accumulations = ma_accumulations[i];
+        o.acc = ma_acc[i];
+        o.acc_w = ma_acc_w[i];
+        o.out = muladd.out[i];
+        store_pipe(muladd, i, ma_head[i], o.output_buff);
+    }
+#endif
+}
+VERSAT_NS_END
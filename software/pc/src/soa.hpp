@@ -0,0 +1,97 @@
+#ifndef VERSAT_SOA_HPP
+#define VERSAT_SOA_HPP
+#include "type.hpp"
+#include <vector>
+
+VERSAT_NS_BEGIN
+
+//
+// Structure-of-arrays engine for the compute FUs
+// Loads the live ALU, ALULite, Mul, BS and MulAdd units of all stages
+// into contiguous arrays, sorted by function, and evaluates each cycle as
+// gather -> per-function kernel -> scatter. The kernels are compiled for
+// AVX2, SSE4.1 and the base instruction set, selected at run time; the
+// groups of a topology are a few units, so only the batched runs, whose
+// kernels cover all the lanes, are long enough to use the vectors.
+// Mem ports stay objects. The object model is the reference: both
+// engines give the same results, and the state is written back to the
+// FU objects at the end of each run.
+//
+
+//kernel on n contiguous units, all with the same function
+typedef void (*soa_op2_t)(int n, const versat_t *a, const versat_t *b, versat_t *out);
+typedef void (*soa_bs_t)(int n, const versat_t *in, const int *shift, versat_t *out);
+typedef void (*soa_gather_t)(int n, const versat_t *databus, const int *sel, versat_t *dst);
+
+struct CSoAKernels
+{
+    const char *isa;
+    soa_op2_t alu[16];
+    soa_op2_t alulite[16]; //out holds the previous result (feedback)
+    soa_op2_t mul[4];
+    soa_bs_t bs[4]; //BS_SHR_A, BS_SHR_L, BS_SHL, no shift
+    soa_gather_t gather;
+};
+
+//kernels of the best instruction set of this CPU
+const CSoAKernels *soa_kernels();
+
+//units of one FU type: operand selectors and output pipeline
+struct CSoAUnits
+{
+    int n = 0;
+    int lat = 1, head = 0;
+    std::vector<int> stage, idx;   //owning object
+    std::vector<int> fns, param;   //function, BS shift
+    std::vector<int> sel_a, sel_b; //global databus index of the operands
+    std::vector<versat_t> a, b, out;
+    std::vector<versat_t> pipe; //lat x n, oldest at head
+    //n_groups ranges of units with the same kernel
+    std::vector<int> group_kernel, group_start, group_n;
+    //databus slots written by each unit (stage 0 units write two)
+    std::vector<int> dst_unit, dst;
+
+    void clear(int lat);
+    void add(VersatInstance *versat, int stage, int idx, int fns, int param, int sel_a, int sel_b, int slot);
+    void alloc();
+    void push();
+    void scatter(versat_t *global_databus);
+};
+
+class CSoAEngine
+{
+public:
+    CSoAEngine();
+
+    //pack the live compute FUs of versat->shadow_reg and their state
+    void load(VersatInstance *versat);
+
+    //calculate new outputs of all units
+    void output(int cycle);
+
+    //shift output pipelines, update databus
+    void update(int cycle);
+
+    //write the unit state back to the FU objects
+    void store(int cycles);
+
+    //instruction set of the kernels in use
+    const char *isa() { return kernels->isa; }
+
+private:
+    VersatInstance *versat = NULL;
+    const CSoAKernels *kernels;
+    CSoAUnits alu, alulite, mul, bs;
+
+    //MulAdds keep per unit start delay, address generator and accumulator
+    CSoAUnits muladd;
+    std::vector<int> ma_delay, ma_iter, ma_per, ma_shift;
+    std::vector<int> ma_done, ma_duty, ma_duty_cnt, ma_enable, ma_shift_addr;
+    std::vector<int> ma_incr, ma_aux, ma_pos, ma_loop1, ma_loop2, ma_cnt_addr, ma_head, ma_accumulations;
+    std::vector<mul_t> ma_acc, ma_acc_w;
+
+    void gather(CSoAUnits &u, bool two);
+    void eval(CSoAUnits &u, soa_op2_t const *ops);
+};
+VERSAT_NS_END
+#endif
@@ -0,0 +1,55 @@
+//
+// SoA engine kernels, included by soa.cpp once per instruction set
+// (inside its own namespace and target pragma, so no include guard)
+// each kernel applies one fixed function to n contiguous units, the
+// function a template constant; the loops vectorize for the target, which
+// pays off on the lanes of batched runs (batch.cpp)
+//
+
+template <int FNS>
+void alu_group(int n, const versat_t *a, const versat_t *b, versat_t *out)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = alu_op<versat_t>(FNS, a[i], b[i]);
+}
+
+template <int FNS>
+void alulite_group(int n, const versat_t *a, const versat_t *b, versat_t *out)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = alulite_op<versat_t>(FNS, a[i], b[i], out[i]);
+}
+
+template <int FNS>
+void mul_group(int n, const versat_t *a, const versat_t *b, versat_t *out)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = mul_op<versat_t>(FNS, a[i], b[i]);
+}
+
+template <int FNS>
+void bs_group(int n, const versat_t *in, const int *shift, versat_t *out)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = bs_op<versat_t>(FNS, in[i], shift[i]);
+}
+
+void gather(int n, const versat_t *databus, const int *sel, versat_t *dst)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = databus[sel[i]];
+}
+
+const CSoAKernels kernels = {
+    SOA_ISA,
+    {alu_group<0>, alu_group<1>, alu_group<2>, alu_group<3>,
+     alu_group<4>, alu_group<5>, alu_group<6>, alu_group<7>,
+     alu_group<8>, alu_group<9>, alu_group<10>, alu_group<11>,
+     alu_group<12>, alu_group<13>, alu_group<14>, alu_group<15>},
+    {alulite_group<0>, alulite_group<1>, alulite_group<2>, alulite_group<3>,
+     alulite_group<4>, alulite_group<5>, alulite_group<6>, alulite_group<7>,
+     alulite_group<8>, alulite_group<9>, alulite_group<10>, alulite_group<11>,
+     alulite_group<12>, alulite_group<13>, alulite_group<14>, alulite_group<15>},
+    {mul_group<0>, mul_group<MUL_HI>, mul_group<MUL_DIV2_LO>, mul_group<MUL_DIV2_HI>},
+    {bs_group<BS_SHR_A>, bs_group<BS_SHR_L>, bs_group<BS_SHL>, bs_group<-1>},
+    gather};
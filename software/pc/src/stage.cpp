@@ -1,50 +1,56 @@
-#include "stage.hpp"
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
 
 CStage::CStage()
 {
 }
 //Default Constructor
-CStage::CStage(int versat_base)
+CStage::CStage(VersatInstance *versat, int versat_base)
 {
 
     //Define control and databus base address
+    this->versat = versat;
     this->versat_base = versat_base;
 
     //set databus pointer
-    this->databus = &(global_databus[(1 << (N_W - 1)) * (nSTAGE - versat_base)]);
-    //special case for first stage
-    if (versat_base == 0)
-    {
-        this->databus = global_databus;
-    }
+    this->databus = &(versat->global_databus[versat->databus_block(versat_base)]);
 
     //Init functional units
     int i;
 #if nMEM > 0
     for (i = 0; i < nMEM; i++)
-        memA[i] = CMemPort(versat_base, i, 0, databus);
+        memA[i] = CMemPort(versat, versat_base, i, 0, databus);
     for (i = 0; i < nMEM; i++)
-        memB[i] = CMemPort(versat_base, i, 1, databus);
+        memB[i] = CMemPort(versat, versat_base, i, 1, databus);
+#endif
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+        vi[i] = CVI(versat, versat_base, i, databus);
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+        vo[i] = CVO(versat, versat_base, i, databus);
 #endif
 #if nALU > 0
     for (i = 0; i < nALU; i++)
-        alu[i] = CALU(versat_base, i, databus);
+        alu[i] = CALU(versat, versat_base, i, databus);
 #endif
 #if nALULITE > 0
     for (i = 0; i < nALULITE; i++)
-        alulite[i] = CALULite(versat_base, i, databus);
+        alulite[i] = CALULite(versat, versat_base, i, databus);
 #endif
 #if nBS > 0
     for (i = 0; i < nBS; i++)
-        bs[i] = CBS(versat_base, i, databus);
+        bs[i] = CBS(versat, versat_base, i, databus);
 #endif
 #if nMUL > 0
     for (i = 0; i < nMUL; i++)
-        mul[i] = CMul(versat_base, i, databus);
+        mul[i] = CMul(versat, versat_base, i, databus);
 #endif
 #if nMULADD > 0
     for (i = 0; i < nMULADD; i++)
-        muladd[i] = CMulAdd(versat_base, i, databus);
+        muladd[i] = CMulAdd(versat, versat_base, i, databus);
 #endif
 }
 
@@ -52,25 +58,180 @@ CStage::CStage(int versat_base)
 void CStage::clearConf()
 {
     int i = versat_base;
-    stage[i] = CStage(i);
+    versat->stage[i] = CStage(versat, i);
 }
 
 #ifdef CONF_MEM_USE
 //write current config in conf_mem
 void CStage::confMemWrite(int addr)
 {
-    if (addr < CONF_MEM_SIZE)
-        MEMSET(versat_base, (CONF_BASE + CONF_MEM + addr), 0);
+    if (addr >= 0 && addr < CONF_MEM_SIZE)
+    {
+        versat->conf_mem[versat_base][addr].copy(*this);
+        versat->conf_mem_cycles += CONF_MEM_WR_CYCLES;
+    }
 }
 
 //set addressed config in conf_mem as current config
 void CStage::confMemRead(int addr)
 {
-    if (addr < CONF_MEM_SIZE)
-        MEMGET(versat_base, (CONF_BASE + CONF_MEM + addr));
+    if (addr >= 0 && addr < CONF_MEM_SIZE)
+    {
+        copy(versat->conf_mem[versat_base][addr]);
+        versat->conf_mem_cycles += CONF_MEM_RD_CYCLES;
+    }
 }
 #endif
 
+static int *memp_field(CMemPort &p, int f)
+{
+    switch (f)
+    {
+    case MEMP_CONF_ITER: return &p.iter;
+    case MEMP_CONF_PER: return &p.per;
+    case MEMP_CONF_DUTY: return &p.duty;
+    case MEMP_CONF_SEL: return &p.sel;
+    case MEMP_CONF_START: return &p.start;
+    case MEMP_CONF_SHIFT: return &p.shift;
+    case MEMP_CONF_INCR: return &p.incr;
+    case MEMP_CONF_DELAY: return &p.delay;
+    case MEMP_CONF_RVRS: return &p.rvrs;
+    case MEMP_CONF_EXT: return &p.ext;
+    case MEMP_CONF_IN_WR: return &p.in_wr;
+    case MEMP_CONF_ITER2: return &p.iter2;
+    case MEMP_CONF_PER2: return &p.per2;
+    case MEMP_CONF_SHIFT2: return &p.shift2;
+    case MEMP_CONF_INCR2: return &p.incr2;
+    }
+    return NULL;
+}
+
+//ALU, ALULite, Mul: SELA, SELB, FNS
+static int *sel_fns_field(int &a, int &b, int &fns, int f)
+{
+    return f == 0 ? &a : f == 1 ? &b : f == 2 ? &fns : NULL;
+}
+
+int *CStage::conf_field(int addr)
+{
+    if (addr < CONF_MEM0A)
+        return NULL;
+#if nMEM > 0
+    //ports interleaved: MEM0A, MEM0B, MEM1A, ...
+    if (addr < CONF_VI0)
+    {
+        int j = (addr - CONF_MEM0A) / MEMP_CONF_OFFSET;
+        return memp_field(j % 2 ? memB[j / 2] : memA[j / 2], (addr - CONF_MEM0A) % MEMP_CONF_OFFSET);
+    }
+#endif
+#if nVI > 0
+    if (addr < CONF_VO0)
+    {
+        CVI &u = vi[(addr - CONF_VI0) / VI_CONF_OFFSET];
+        switch ((addr - CONF_VI0) % VI_CONF_OFFSET)
+        {
+        case VI_CONF_EXT_ADDR: return &u.ext.ext_addr;
+        case VI_CONF_INT_ADDR: return &u.ext.int_addr;
+        case VI_CONF_SIZE: return &u.ext.size;
+        case VI_CONF_ITER_A: return &u.ext.iter;
+        case VI_CONF_PER_A: return &u.ext.per;
+        case VI_CONF_DUTY_A: return &u.ext.duty;
+        case VI_CONF_SHIFT_A: return &u.ext.shift;
+        case VI_CONF_INCR_A: return &u.ext.incr;
+        case VI_CONF_ITER_B: return &u.port.iter;
+        case VI_CONF_PER_B: return &u.port.per;
+        case VI_CONF_DUTY_B: return &u.port.duty;
+        case VI_CONF_START_B: return &u.port.start;
+        case VI_CONF_SHIFT_B: return &u.port.shift;
+        case VI_CONF_INCR_B: return &u.port.incr;
+        case VI_CONF_DELAY_B: return &u.port.delay;
+        case VI_CONF_RVRS_B: return &u.port.rvrs;
+        case VI_CONF_EXT_B: return &u.port.ext;
+        case VI_CONF_ITER2_B: return &u.port.iter2;
+        case VI_CONF_PER2_B: return &u.port.per2;
+        case VI_CONF_SHIFT2_B: return &u.port.shift2;
+        case VI_CONF_INCR2_B: return &u.port.incr2;
+        }
+    }
+#endif
+#if nVO > 0
+    if (addr < CONF_ALU0)
+    {
+        CVO &u = vo[(addr - CONF_VO0) / VO_CONF_OFFSET];
+        switch ((addr - CONF_VO0) % VO_CONF_OFFSET)
+        {
+        case VO_CONF_EXT_ADDR: return &u.ext.ext_addr;
+        case VO_CONF_INT_ADDR: return &u.ext.int_addr;
+        case VO_CONF_SIZE: return &u.ext.size;
+        case VO_CONF_ITER_A: return &u.ext.iter;
+        case VO_CONF_PER_A: return &u.ext.per;
+        case VO_CONF_DUTY_A: return &u.ext.duty;
+        case VO_CONF_SHIFT_A: return &u.ext.shift;
+        case VO_CONF_INCR_A: return &u.ext.incr;
+        case VO_CONF_ITER_B: return &u.port.iter;
+        case VO_CONF_PER_B: return &u.port.per;
+        case VO_CONF_DUTY_B: return &u.port.duty;
+        case VO_CONF_SEL_B: return &u.port.sel;
+        case VO_CONF_START_B: return &u.port.start;
+        case VO_CONF_SHIFT_B: return &u.port.shift;
+        case VO_CONF_INCR_B: return &u.port.incr;
+        case VO_CONF_DELAY_B: return &u.port.delay;
+        case VO_CONF_RVRS_B: return &u.port.rvrs;
+        case VO_CONF_EXT_B: return &u.port.ext;
+        case VO_CONF_ITER2_B: return &u.port.iter2;
+        case VO_CONF_PER2_B: return &u.port.per2;
+        case VO_CONF_SHIFT2_B: return &u.port.shift2;
+        case VO_CONF_INCR2_B: return &u.port.incr2;
+        }
+    }
+#endif
+#if nALU > 0
+    if (addr < CONF_ALULITE0)
+    {
+        CALU &u = alu[(addr - CONF_ALU0) / ALU_CONF_OFFSET];
+        return sel_fns_field(u.opa, u.opb, u.fns, (addr - CONF_ALU0) % ALU_CONF_OFFSET);
+    }
+#endif
+#if nALULITE > 0
+    if (addr < CONF_MUL0)
+    {
+        CALULite &u = alulite[(addr - CONF_ALULITE0) / ALULITE_CONF_OFFSET];
+        return sel_fns_field(u.opa, u.opb, u.fns, (addr - CONF_ALULITE0) % ALULITE_CONF_OFFSET);
+    }
+#endif
+#if nMUL > 0
+    if (addr < CONF_MULADD0)
+    {
+        CMul &u = mul[(addr - CONF_MUL0) / MUL_CONF_OFFSET];
+        return sel_fns_field(u.sela, u.selb, u.fns, (addr - CONF_MUL0) % MUL_CONF_OFFSET);
+    }
+#endif
+#if nMULADD > 0
+    if (addr < CONF_BS0)
+    {
+        CMulAdd &u = muladd[(addr - CONF_MULADD0) / MULADD_CONF_OFFSET];
+        switch ((addr - CONF_MULADD0) % MULADD_CONF_OFFSET)
+        {
+        case MULADD_CONF_SELA: return &u.sela;
+        case MULADD_CONF_SELB: return &u.selb;
+        case MULADD_CONF_FNS: return &u.fns;
+        case MULADD_CONF_ITER: return &u.iter;
+        case MULADD_CONF_PER: return &u.per;
+        case MULADD_CONF_DELAY: return &u.delay;
+        case MULADD_CONF_SHIFT: return &u.shift;
+        }
+    }
+#endif
+#if nBS > 0
+    if (addr < CONF_BS0 + nBS * BS_CONF_OFFSET)
+    {
+        CBS &u = bs[(addr - CONF_BS0) / BS_CONF_OFFSET];
+        return sel_fns_field(u.data, u.shift, u.fns, (addr - CONF_BS0) % BS_CONF_OFFSET);
+    }
+#endif
+    return NULL;
+}
+
 //set run start on all FUs
 void CStage::start_all_FUs()
 {
@@ -79,6 +240,14 @@ void CStage::start_all_FUs()
         memA[i].start_run();
     for (i = 0; i < nMEM; i++)
         memB[i].start_run();
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+        vi[i].start_run();
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+        vo[i].start_run();
+#endif
 #if nALU > 0
     for (i = 0; i < nALU; i++)
         alu[i].start_run();
@@ -101,67 +270,145 @@ void CStage::start_all_FUs()
 #endif
 }
 
+//update output buffers of the mem ports, advance the run cycle
+void CStage::update_mem_ports()
+{
+    for (int i = 0; i < n_active_mem; i++)
+    {
+        CMemPort &port = mem_port(active_mem[i]);
+        port.update();
+        //output FIFO drained after done: output is constant from now on
+        if (port.retired())
+        {
+            for (int k = i + 1; k < n_active_mem; k++)
+                active_mem[k - 1] = active_mem[k];
+            n_active_mem--;
+            i--;
+        }
+    }
+#if nVI > 0
+    for (int i = 0; i < nVI; i++)
+        vi[i].update();
+#endif
+#if nVO > 0
+    for (int i = 0; i < nVO; i++)
+        vo[i].update();
+#endif
+    cycle++;
+}
+
 //set update output buffers on all FUs
 void CStage::update_all_FUs()
 {
     int i = 0;
-    for (i = 0; i < nMEM; i++)
-        memA[i].update();
-    for (i = 0; i < nMEM; i++)
-        memB[i].update();
+    update_mem_ports();
 #if nALU > 0
-    for (i = 0; i < nALU; i++)
-        alu[i].update();
+    for (i = 0; i < n_active_alu; i++)
+        alu[active_alu[i]].update();
 #endif
 #if nALULITE > 0
-    for (i = 0; i < nALULITE; i++)
-        alulite[i].update();
+    for (i = 0; i < n_active_alulite; i++)
+        alulite[active_alulite[i]].update();
 #endif
 #if nBS > 0
-    for (i = 0; i < nBS; i++)
-        bs[i].update();
+    for (i = 0; i < n_active_bs; i++)
+        bs[active_bs[i]].update();
 #endif
 #if nMUL > 0
-    for (i = 0; i < nMUL; i++)
-        mul[i].update();
+    for (i = 0; i < n_active_mul; i++)
+        mul[active_mul[i]].update();
 #endif
 #if nMULADD > 0
-    for (i = 0; i < nMULADD; i++)
-        muladd[i].update();
+    for (i = 0; i < n_active_muladd; i++)
+        muladd[active_muladd[i]].update();
 #endif
 }
 
+//mem ports waiting for their delay only count it down, wake them when it ends
+void CStage::wake_mem_ports()
+{
+    for (int i = 0; i < n_wait_mem; i++)
+    {
+        int j = wait_mem[i];
+        if (mem_port(j).delay > cycle)
+            continue;
+        wait_mem[i--] = wait_mem[--n_wait_mem];
+        mem_port(j).wake();
+        //keep port order, ports sharing a memory access it in that order
+        int k;
+        for (k = n_active_mem++; k > 0 && active_mem[k - 1] > j; k--)
+            active_mem[k] = active_mem[k - 1];
+        active_mem[k] = j;
+    }
+}
+
+//calculate new output of the mem ports
+void CStage::output_mem_ports()
+{
+    int i = 0;
+
+    wake_mem_ports();
+    for (i = 0; i < n_active_mem; i++)
+        mem_port(active_mem[i]).output();
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+        vi[i].output();
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+        vo[i].output();
+#endif
+}
+
+#if nMULADD > 0
+//MulAdds waiting for their delay only count it down, wake them when it ends
+void CStage::wake_muladds()
+{
+    for (int i = 0; i < n_wait_muladd; i++)
+    {
+        int j = wait_muladd[i];
+        if (muladd[j].delay > cycle)
+            continue;
+        wait_muladd[i--] = wait_muladd[--n_wait_muladd];
+        muladd[j].wake();
+        active_muladd[n_active_muladd++] = j;
+    }
+}
+#endif
+
 //calculate new output on all FUs
 void CStage::output_all_FUs()
 {
     int i = 0;
-    for (i = 0; i < nMEM; i++)
-        memA[i].output();
-    for (i = 0; i < nMEM; i++)
-        memB[i].output();
+
+    output_mem_ports();
+#if nMULADD > 0
+    wake_muladds();
+#endif
+
 #if nALU > 0
-    for (i = 0; i < nALU; i++)
-        alu[i].output();
+    for (i = 0; i < n_active_alu; i++)
+        alu[active_alu[i]].output();
 #endif
 #if nALULITE > 0
-    for (i = 0; i < nALULITE; i++)
-        alulite[i].output();
+    for (i = 0; i < n_active_alulite; i++)
+        alulite[active_alulite[i]].output();
 #endif
 #if nBS > 0
-    for (i = 0; i < nBS; i++)
-        bs[i].output();
+    for (i = 0; i < n_active_bs; i++)
+        bs[active_bs[i]].output();
 #endif
 #if nMUL > 0
-    for (i = 0; i < nMUL; i++)
-        mul[i].output();
+    for (i = 0; i < n_active_mul; i++)
+        mul[active_mul[i]].output();
 #endif
 #if nMULADD > 0
-    for (i = 0; i < nMULADD; i++)
-        muladd[i].output();
+    for (i = 0; i < n_active_muladd; i++)
+        muladd[active_muladd[i]].output();
 #endif
 }
 
-void CStage::copy(CStage that)
+void CStage::copy(const CStage &that)
 {
     int i = 0;
 #if nMEM > 0
@@ -172,6 +419,14 @@ void CStage::copy(CStage that)
         this->memB[i].copy(that.memB[i]);
     }
 #endif
+#if nVI > 0
+    for (i = 0; i < nVI; i = i + 1)
+        this->vi[i].copy(that.vi[i]);
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i = i + 1)
+        this->vo[i].copy(that.vo[i]);
+#endif
 #if nALU > 0
     //ALUs
     for (i = 0; i < nALU; i = i + 1)
@@ -213,6 +468,47 @@ void CStage::copy(CStage that)
 #endif
 }
 
+void CStage::state(CCheckpoint &c)
+{
+    int i;
+    c.io(cycle);
+#if nMEM > 0
+    for (i = 0; i < nMEM; i++)
+    {
+        memA[i].state(c);
+        memB[i].state(c);
+    }
+#endif
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+        vi[i].state(c);
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+        vo[i].state(c);
+#endif
+#if nALU > 0
+    for (i = 0; i < nALU; i++)
+        alu[i].state(c);
+#endif
+#if nALULITE > 0
+    for (i = 0; i < nALULITE; i++)
+        alulite[i].state(c);
+#endif
+#if nMUL > 0
+    for (i = 0; i < nMUL; i++)
+        mul[i].state(c);
+#endif
+#if nMULADD > 0
+    for (i = 0; i < nMULADD; i++)
+        muladd[i].state(c);
+#endif
+#if nBS > 0
+    for (i = 0; i < nBS; i++)
+        bs[i].state(c);
+#endif
+}
+
 bool CStage::done()
 {
     bool auxA, auxB;
@@ -223,6 +519,14 @@ bool CStage::done()
         auxA = auxA && memA[i].done;
         auxB = auxB && memB[i].done;
     }
+#if nVI > 0
+    for (int i = 0; i < nVI; i++)
+        auxA = auxA && vi[i].done();
+#endif
+#if nVO > 0
+    for (int i = 0; i < nVO; i++)
+        auxA = auxA && vo[i].done();
+#endif
     return auxA && auxB;
 }
 
@@ -237,6 +541,14 @@ void CStage::reset()
         memA[i].done = 0;
         memB[i].done = 0;
     }
+#if nVI > 0
+    for (int i = 0; i < nVI; i++)
+        vi[i].port.done = vi[i].ext.done = 0;
+#endif
+#if nVO > 0
+    for (int i = 0; i < nVO; i++)
+        vo[i].port.done = vo[i].ext.done = 0;
+#endif
 }
 string CStage::info()
 {
@@ -249,6 +561,14 @@ string CStage::info()
         ver += memB[i].info();
     }
 #endif
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+        ver += vi[i].info();
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+        ver += vo[i].info();
+#endif
 #if nALU > 0
     for (i = 0; i < nALU; i++)
     {
@@ -294,6 +614,14 @@ string CStage::info_iter()
         ver += memB[i].info_iter();
     }
 #endif
+#if nVI > 0
+    for (i = 0; i < nVI; i++)
+        ver += vi[i].info_iter();
+#endif
+#if nVO > 0
+    for (i = 0; i < nVO; i++)
+        ver += vo[i].info_iter();
+#endif
 #if nALU > 0
     for (i = 0; i < nALU; i++)
     {
@@ -326,3 +654,4 @@ string CStage::info_iter()
 #endif
     return ver;
 }
+VERSAT_NS_END
@@ -1,3 +1,5 @@
+#ifndef VERSAT_STAGE_HPP
+#define VERSAT_STAGE_HPP
 #include "type.hpp"
 #include "alu.hpp"
 #include "alu_lite.hpp"
@@ -5,10 +7,16 @@
 #include "mem.hpp"
 #include "mul.hpp"
 #include "mul_add.hpp"
+#include "vread.hpp"
+#include "vwrite.hpp"
+#include "confimg.hpp"
+
+VERSAT_NS_BEGIN
 class CStage
 {
 private:
 public:
+    VersatInstance *versat = NULL;
     int versat_base;
     versat_t *databus;
     //versat_t* databus[N*2];
@@ -17,6 +25,12 @@ public:
     CMemPort memA[nMEM];
     CMemPort memB[nMEM];
 #endif
+#if nVI > 0
+    CVI vi[nVI];
+#endif
+#if nVO > 0
+    CVO vo[nVO];
+#endif
 #if nALU > 0
     CALU alu[nALU];
 #endif
@@ -33,18 +47,43 @@ public:
     CMulAdd muladd[nMULADD];
 #endif
 
+    //FUs evaluated in the current run, built from the shadow
+    //configuration by VersatInstance::build_active_FUs()
+    //mem ports are indexed 0..nMEM-1 for memA and nMEM..2*nMEM-1 for memB
+    int cycle = 0;
+    int n_active_mem = 0, active_mem[2 * nMEM];
+    int n_wait_mem = 0, wait_mem[2 * nMEM]; //waiting for their start delay
+#if nALU > 0
+    int n_active_alu = 0, active_alu[nALU];
+#endif
+#if nALULITE > 0
+    int n_active_alulite = 0, active_alulite[nALULITE];
+#endif
+#if nBS > 0
+    int n_active_bs = 0, active_bs[nBS];
+#endif
+#if nMUL > 0
+    int n_active_mul = 0, active_mul[nMUL];
+#endif
+#if nMULADD > 0
+    int n_active_muladd = 0, active_muladd[nMULADD];
+    int n_wait_muladd = 0, wait_muladd[nMULADD];
+#endif
+
     //Default constructor
     CStage();
-    //Default Constructor
-    CStage(int versat_base);
+    //Constructor for stage versat_base of a versat instance
+    CStage(VersatInstance *versat, int versat_base);
     //clear Versat config
     void clearConf();
 
 #ifdef CONF_MEM_USE
     //write current config in conf_mem
+    //(costs CONF_MEM_WR_CYCLES, added to versat->conf_mem_cycles)
     void confMemWrite(int addr);
 
     //set addressed config in conf_mem as current config
+    //(costs CONF_MEM_RD_CYCLES, added to versat->conf_mem_cycles)
     void confMemRead(int addr);
 #endif
 
@@ -56,7 +95,35 @@ public:
 
     //calculate new output on all FUs
     void output_all_FUs();
-    void copy(CStage that);
+
+    //mem port and VI/VO part of output_all_FUs()/update_all_FUs(), used by
+    //the SoA engine which evaluates the compute FUs itself
+    void output_mem_ports();
+    void update_mem_ports();
+
+    //move the mem ports and MulAdds whose start delay ends this cycle to
+    //the active lists (part of the output phase)
+    void wake_mem_ports();
+#if nMULADD > 0
+    void wake_muladds();
+#endif
+
+    //memA (j < nMEM) or memB (j >= nMEM) port
+    CMemPort &mem_port(int j) { return j < nMEM ? memA[j] : memB[j - nMEM]; }
+
+    //configuration field of register addr of the stage map of xconfdefs.vh
+    //(CONF_MEM0A + j * MEMP_CONF_OFFSET + MEMP_CONF_ITER, ...), where the
+    //firmware writes it; NULL if addr is not a field
+    int *conf_field(int addr);
+
+    //configuration to/from its unpacked form (confimg.hpp)
+    void get_conf(CStageConf &c);
+    void set_conf(const CStageConf &c);
+
+    void copy(const CStage &that);
+    //save/load the configuration and state of all FUs (checkpoint.hpp)
+    //the FU lists are not saved, they are rebuilt when a run resumes
+    void state(CCheckpoint &c);
     string info();
     string info_iter();
 
@@ -65,36 +132,5 @@ public:
 
 }; //end class CStage
 
-extern int base;
-extern CStage stage[nSTAGE];
-extern CStage shadow_reg[nSTAGE];
-extern CMem versat_mem[nSTAGE][nMEM];
-extern int versat_iter;
-extern versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
-/*databus vector
-stage 0 is repeated in the start and at the end
-stage order in databus
-[ 0 | nSTAGE-1 | nSTAGE-2 | ... | 2  | 1 | 0 ]
-^                                    ^
-|                                    |
-stage 0 databus                      stage 1 databus
-
-*/
-#if nMEM > 0
-extern int sMEMA[nMEM], sMEMA_p[nMEM], sMEMB[nMEM], sMEMB_p[nMEM];
-#endif
-#if nALU > 0
-extern int sALU[nALU], sALU_p[nALU];
-#endif
-#if nALULITE > 0
-extern int sALULITE[nALULITE], sALULITE_p[nALULITE];
-#endif
-#if nMUL > 0
-extern int sMUL[nMUL], sMUL_p[nMUL];
-#endif
-#if nMULADD > 0
-extern int sMULADD[nMULADD], sMULADD_p[nMULADD];
+VERSAT_NS_END
 #endif
-#if nBS > 0
-extern int sBS[nBS], sBS_p[nBS];
-#endif
\ No newline at end of file
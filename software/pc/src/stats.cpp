@@ -0,0 +1,189 @@
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
+
+//done cycle of a stage: its last memory to finish
+static void last_done(int &done_cycle, int unit_cycle)
+{
+    if (done_cycle < 0 || unit_cycle < 0)
+        done_cycle = -1;
+    else if (unit_cycle > done_cycle)
+        done_cycle = unit_cycle;
+}
+
+#if nVI > 0 || nVO > 0
+static void vio_stats(CVIOStats &st, CMemPort &port, CExtAddrGen &ext, int cycles)
+{
+    port.stats(st.port, cycles);
+    st.ext_transfers = ext.transfers();
+    //the transfer after the last issued one finds the counter past the size
+    st.ext_done_cycle = ext.done ? ext.transfers() : -1;
+}
+#endif
+
+//compute FUs work on every cycle of a run they are simulated in
+static void fu_stats(CFUStats *st, int n, int *active, int n_active, int cycles)
+{
+    for (int i = 0; i < n; i++)
+        st[i] = {0, 0, 0};
+    for (int i = 0; i < n_active; i++)
+        st[active[i]].active_cycles = cycles;
+}
+
+CRunStats VersatInstance::run_stats()
+{
+    wait();
+    CRunStats rs;
+    memset(&rs, 0, sizeof(rs));
+    int cycles = versat_iter;
+    rs.cycles = cycles;
+    rs.paused = run_paused;
+#ifdef CONF_MEM_USE
+    rs.conf_mem_cycles = conf_mem_cycles;
+#endif
+    for (int s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = shadow_reg[s];
+        CStageStats &ss = rs.stage[s];
+        int i;
+        ss.done_cycle = 0;
+#if nMEM > 0
+        for (i = 0; i < nMEM; i++)
+        {
+            st.memA[i].stats(ss.mem_a[i], cycles);
+            st.memB[i].stats(ss.mem_b[i], cycles);
+            last_done(ss.done_cycle, ss.mem_a[i].done_cycle);
+            last_done(ss.done_cycle, ss.mem_b[i].done_cycle);
+        }
+#endif
+#if nVI > 0
+        for (i = 0; i < nVI; i++)
+        {
+            vio_stats(ss.vi[i], st.vi[i].port, st.vi[i].ext, cycles);
+            last_done(ss.done_cycle, ss.vi[i].port.done_cycle);
+            last_done(ss.done_cycle, ss.vi[i].ext_done_cycle);
+        }
+#endif
+#if nVO > 0
+        for (i = 0; i < nVO; i++)
+        {
+            vio_stats(ss.vo[i], st.vo[i].port, st.vo[i].ext, cycles);
+            last_done(ss.done_cycle, ss.vo[i].port.done_cycle);
+            last_done(ss.done_cycle, ss.vo[i].ext_done_cycle);
+        }
+#endif
+#if nALU > 0
+        fu_stats(ss.alu, nALU, st.active_alu, st.n_active_alu, cycles);
+#endif
+#if nALULITE > 0
+        fu_stats(ss.alulite, nALULITE, st.active_alulite, st.n_active_alulite, cycles);
+#endif
+#if nMUL > 0
+        fu_stats(ss.mul, nMUL, st.active_mul, st.n_active_mul, cycles);
+#endif
+#if nBS > 0
+        fu_stats(ss.bs, nBS, st.active_bs, st.n_active_bs, cycles);
+#endif
+#if nMULADD > 0
+        for (i = 0; i < nMULADD; i++)
+        {
+            bool live = 0;
+            for (int j = 0; j < st.n_active_muladd; j++)
+                live = live || st.active_muladd[j] == i;
+            for (int j = 0; j < st.n_wait_muladd; j++)
+                live = live || st.wait_muladd[j] == i;
+            st.muladd[i].stats(ss.muladd[i], cycles, live);
+        }
+#endif
+    }
+    return rs;
+}
+
+//
+// JSON dump
+//
+static void json_port(FILE *f, const CPortStats &p)
+{
+    fprintf(f, "{\"delay_cycles\": %d, \"active_cycles\": %d, \"enabled_cycles\": %d, \"idle_cycles\": %d, "
+               "\"reads\": %d, \"writes\": %d, \"done_cycle\": %d}",
+            p.delay_cycles, p.active_cycles, p.enabled_cycles, p.idle_cycles, p.reads, p.writes, p.done_cycle);
+}
+
+static void json_fu(FILE *f, const CFUStats &u)
+{
+    fprintf(f, "{\"active_cycles\": %d, \"delay_cycles\": %d, \"accumulations\": %d}",
+            u.active_cycles, u.delay_cycles, u.accumulations);
+}
+
+#if nVI > 0 || nVO > 0
+static void json_vio(FILE *f, const CVIOStats &v)
+{
+    fprintf(f, "{\"port\": ");
+    json_port(f, v.port);
+    fprintf(f, ", \"ext_transfers\": %d, \"ext_done_cycle\": %d}", v.ext_transfers, v.ext_done_cycle);
+}
+#endif
+
+//"name": [unit, ...] of n units, print(f, unit)
+template <class T>
+static void json_list(FILE *f, const char *name, const T *units, int n, void (*print)(FILE *, const T &))
+{
+    fprintf(f, ",\n      \"%s\": [", name);
+    for (int i = 0; i < n; i++)
+    {
+        fprintf(f, i ? ",\n        " : "\n        ");
+        print(f, units[i]);
+    }
+    fprintf(f, "]");
+}
+
+int VersatInstance::save_run_stats(const char *path)
+{
+    CRunStats rs = run_stats();
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    fprintf(f, "{\n  \"cycles\": %d,\n  \"paused\": %d,\n", rs.cycles, rs.paused);
+#ifdef CONF_MEM_USE
+    fprintf(f, "  \"conf_mem_cycles\": %d,\n", rs.conf_mem_cycles);
+#endif
+    fprintf(f, "  \"stages\": [");
+    for (int s = 0; s < nSTAGE; s++)
+    {
+        const CStageStats &ss = rs.stage[s];
+        fprintf(f, "%s\n    {\n      \"stage\": %d,\n      \"done_cycle\": %d", s ? "," : "", s, ss.done_cycle);
+#if nMEM > 0
+        json_list(f, "memA", ss.mem_a, nMEM, json_port);
+        json_list(f, "memB", ss.mem_b, nMEM, json_port);
+#endif
+#if nVI > 0
+        json_list(f, "vi", ss.vi, nVI, json_vio);
+#endif
+#if nVO > 0
+        json_list(f, "vo", ss.vo, nVO, json_vio);
+#endif
+#if nALU > 0
+        json_list(f, "alu", ss.alu, nALU, json_fu);
+#endif
+#if nALULITE > 0
+        json_list(f, "alulite", ss.alulite, nALULITE, json_fu);
+#endif
+#if nMUL > 0
+        json_list(f, "mul", ss.mul, nMUL, json_fu);
+#endif
+#if nMULADD > 0
+        json_list(f, "muladd", ss.muladd, nMULADD, json_fu);
+#endif
+#if nBS > 0
+        json_list(f, "bs", ss.bs, nBS, json_fu);
+#endif
+        fprintf(f, "\n    }");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return 0;
+}
+VERSAT_NS_END
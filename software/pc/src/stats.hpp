@@ -0,0 +1,78 @@
+#ifndef VERSAT_STATS_HPP
+#define VERSAT_STATS_HPP
+#include "type.hpp"
+
+VERSAT_NS_BEGIN
+
+//
+// Run statistics
+// Per-FU counters of the last run, at its end or at a run break. Mem ports
+// and MulAdds count their AGU steps and accumulations as they run; start
+// delays, done cycles and the activity of the other FUs follow from the
+// configuration, the FUs simulated and the run cycle.
+//
+struct CPortStats
+{
+    int delay_cycles;   //waiting for the start delay
+    int active_cycles;  //AGU steps, one per cycle from the delay to done
+    int enabled_cycles; //steps with the enable set
+    int idle_cycles;    //steps in duty gaps
+    int reads, writes;  //memory accesses
+    int done_cycle;     //run cycle of the last step, -1 if not done
+};
+
+//VI/VO: internal port and external transfers
+struct CVIOStats
+{
+    CPortStats port;
+    int ext_transfers;
+    int ext_done_cycle; //-1 if not done
+};
+
+struct CFUStats
+{
+    int active_cycles; //cycles computing an output used in the run
+    int delay_cycles;  //MulAdd start delay
+    int accumulations; //MulAdd results added to the accumulator
+};
+
+struct CStageStats
+{
+    int done_cycle; //run cycle the last memory finished at, -1 if not done
+#if nMEM > 0
+    CPortStats mem_a[nMEM], mem_b[nMEM];
+#endif
+#if nVI > 0
+    CVIOStats vi[nVI];
+#endif
+#if nVO > 0
+    CVIOStats vo[nVO];
+#endif
+#if nALU > 0
+    CFUStats alu[nALU];
+#endif
+#if nALULITE > 0
+    CFUStats alulite[nALULITE];
+#endif
+#if nMUL > 0
+    CFUStats mul[nMUL];
+#endif
+#if nMULADD > 0
+    CFUStats muladd[nMULADD];
+#endif
+#if nBS > 0
+    CFUStats bs[nBS];
+#endif
+};
+
+struct CRunStats
+{
+    int cycles; //run cycles simulated
+    int paused; //stopped at a run break
+#ifdef CONF_MEM_USE
+    int conf_mem_cycles;
+#endif
+    CStageStats stage[nSTAGE];
+};
+VERSAT_NS_END
+#endif
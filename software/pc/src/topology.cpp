@@ -0,0 +1,93 @@
+#include "versat.hpp"
+#include <ctype.h>
+#include <fstream>
+#include <sstream>
+
+VERSAT_NS_BEGIN
+
+CTopology compiled_topology()
+{
+    return build_topology;
+}
+
+//value of "key" in the flat object of json: number, true or false
+//returns 0, or -1 if key is missing
+static int json_int(const string &json, const char *key, int &val)
+{
+    size_t p = json.find("\"" + string(key) + "\"");
+    if (p == string::npos)
+        return -1;
+    p = json.find(':', p);
+    if (p == string::npos)
+        return -1;
+    for (p++; p < json.size() && isspace(json[p]); p++)
+        ;
+    if (json.compare(p, 4, "true") == 0)
+        val = 1;
+    else if (json.compare(p, 5, "false") == 0)
+        val = 0;
+    else if (p < json.size() && (isdigit(json[p]) || json[p] == '-'))
+        val = atoi(json.c_str() + p);
+    else
+        return -1;
+    return 0;
+}
+
+int read_topology(const char *path, CTopology &t)
+{
+    ifstream f(path);
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    stringstream ss;
+    ss << f.rdbuf();
+    string json = ss.str();
+
+    //parameters of mkvhdr.py/mkhdr.py
+    struct
+    {
+        const char *key;
+        int *val;
+    } param[] = {{"nSTAGE", &t.n_stage}, {"nMEM", &t.n_mem}, {"nVI", &t.n_vi}, {"nVO", &t.n_vo},
+                 {"nALU", &t.n_alu}, {"nALULITE", &t.n_alulite}, {"nMUL", &t.n_mul},
+                 {"nMULADD", &t.n_muladd}, {"nBS", &t.n_bs}, {"MEM_ADDR_W", &t.mem_addr_w},
+                 {"DATAPATH_W", &t.datapath_w}, {"CONF_MEM_ADDR_W", &t.conf_mem_addr_w}};
+    for (auto &p : param)
+        if (json_int(json, p.key, *p.val))
+        {
+            printf("Invalid topology %s: no %s\n", path, p.key);
+            return -1;
+        }
+    if (json_int(json, "CONF_MEM_USE", t.conf_mem_use))
+        t.conf_mem_use = 0;
+    if (json_int(json, "MULADD_COMB", t.muladd_comb))
+        t.muladd_comb = 0;
+    return 0;
+}
+
+bool topology_fits(const CTopology &t)
+{
+    CTopology c = compiled_topology();
+    struct
+    {
+        const char *key;
+        int val, min, max;
+    } param[] = {{"nSTAGE", t.n_stage, 1, c.n_stage}, {"nMEM", t.n_mem, 0, c.n_mem}, {"nVI", t.n_vi, 0, c.n_vi},
+                 {"nVO", t.n_vo, 0, c.n_vo}, {"nALU", t.n_alu, 0, c.n_alu}, {"nALULITE", t.n_alulite, 0, c.n_alulite},
+                 {"nMUL", t.n_mul, 0, c.n_mul}, {"nMULADD", t.n_muladd, 0, c.n_muladd}, {"nBS", t.n_bs, 0, c.n_bs},
+                 {"MEM_ADDR_W", t.mem_addr_w, 1, c.mem_addr_w}, {"DATAPATH_W", t.datapath_w, c.datapath_w, c.datapath_w},
+                 {"CONF_MEM_ADDR_W", t.conf_mem_addr_w, 0, t.conf_mem_use ? c.conf_mem_addr_w : 32},
+                 {"CONF_MEM_USE", t.conf_mem_use, 0, c.conf_mem_use},
+                 {"MULADD_COMB", t.muladd_comb, c.muladd_comb, c.muladd_comb}};
+    bool ok = 1;
+    for (auto &p : param)
+        if (p.val < p.min || p.val > p.max)
+        {
+            printf("Invalid topology: %s = %d, this build simulates %d to %d\n", p.key, p.val, p.min, p.max);
+            ok = 0;
+        }
+    return ok;
+}
+VERSAT_NS_END
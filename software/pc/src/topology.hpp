@@ -0,0 +1,50 @@
+#ifndef VERSAT_TOPOLOGY_HPP
+#define VERSAT_TOPOLOGY_HPP
+#include "type.hpp"
+
+VERSAT_NS_BEGIN
+
+//
+// Runtime topology
+// A build sizes its arrays from the topology of versat.h, the envelope.
+// An instance can then simulate any smaller topology, read from the
+// xversat.json of the design point, without a rebuild: fewer stages close
+// the ring earlier, FUs past the runtime counts do not exist and memories
+// are addressed with the runtime MEM_ADDR_W. DATAPATH_W (versat_t) and the
+// FU latencies stay those of the build.
+// Configurations use the selectors of the envelope, sMEMA[] ..., as
+// before; sel_to_hw()/sel_from_hw() of VersatInstance translate them to
+// and from the databus numbering of the runtime topology.
+//
+struct CTopology
+{
+    int n_stage, n_mem, n_vi, n_vo, n_alu, n_alulite, n_mul, n_muladd, n_bs;
+    int mem_addr_w, datapath_w, conf_mem_addr_w;
+    int conf_mem_use, muladd_comb;
+};
+
+//topology of the build, as constants
+#ifdef CONF_MEM_USE
+#define TOPOLOGY_CONF_MEM_USE 1
+#else
+#define TOPOLOGY_CONF_MEM_USE 0
+#endif
+#ifdef MULADD_COMB
+#define TOPOLOGY_MULADD_COMB 1
+#else
+#define TOPOLOGY_MULADD_COMB 0
+#endif
+constexpr CTopology build_topology = {nSTAGE, nMEM, nVI, nVO, nALU, nALULITE, nMUL, nMULADD, nBS,
+                                      MEM_ADDR_W, DATAPATH_W, CONF_MEM_ADDR_W,
+                                      TOPOLOGY_CONF_MEM_USE, TOPOLOGY_MULADD_COMB};
+CTopology compiled_topology();
+
+//parse the xversat.json at path, missing booleans are false
+//returns 0, or -1 if it cannot be read or lacks a parameter
+int read_topology(const char *path, CTopology &t);
+
+//t fits the arrays and matches the widths and latencies of the build,
+//message otherwise
+bool topology_fits(const CTopology &t);
+VERSAT_NS_END
+#endif
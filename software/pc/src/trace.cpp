@@ -0,0 +1,216 @@
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
+
+void CTraceWriter::add(std::vector<CTraceSignal> &sig, VersatInstance *versat, int s, int sel, const char *name, int i)
+{
+    CTraceSignal e;
+    memset(&e, 0, sizeof(e));
+    e.stage = s;
+    e.sel = sel;
+    snprintf(e.name, sizeof(e.name), "%s%d", name, i);
+    sig.push_back(e);
+    slot.push_back(&versat->shadow_reg[s].databus[sel]);
+}
+
+int CTraceWriter::open(VersatInstance *versat, const char *path, uint64_t stage_mask, int fu_mask)
+{
+    close();
+    f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+
+    //signals in databus order
+    std::vector<CTraceSignal> sig;
+    slot.clear();
+    for (int s = 0; s < nSTAGE; s++)
+    {
+        if (s >= 64 || !((stage_mask >> s) & 1))
+            continue;
+        int i;
+#if nMEM > 0
+        if (fu_mask & TRACE_MEM)
+            for (i = 0; i < nMEM; i++)
+            {
+                add(sig, versat, s, versat->sMEMA[i], "memA", i);
+                add(sig, versat, s, versat->sMEMB[i], "memB", i);
+            }
+#endif
+#if nVI > 0
+        if (fu_mask & TRACE_VI)
+            for (i = 0; i < nVI; i++)
+                add(sig, versat, s, versat->sVI[i], "vi", i);
+#endif
+#if nALU > 0
+        if (fu_mask & TRACE_ALU)
+            for (i = 0; i < nALU; i++)
+                add(sig, versat, s, versat->sALU[i], "alu", i);
+#endif
+#if nALULITE > 0
+        if (fu_mask & TRACE_ALULITE)
+            for (i = 0; i < nALULITE; i++)
+                add(sig, versat, s, versat->sALULITE[i], "alulite", i);
+#endif
+#if nMUL > 0
+        if (fu_mask & TRACE_MUL)
+            for (i = 0; i < nMUL; i++)
+                add(sig, versat, s, versat->sMUL[i], "mul", i);
+#endif
+#if nMULADD > 0
+        if (fu_mask & TRACE_MULADD)
+            for (i = 0; i < nMULADD; i++)
+                add(sig, versat, s, versat->sMULADD[i], "muladd", i);
+#endif
+#if nBS > 0
+        if (fu_mask & TRACE_BS)
+            for (i = 0; i < nBS; i++)
+                add(sig, versat, s, versat->sBS[i], "bs", i);
+#endif
+    }
+    last.assign(slot.size(), 0);
+    run_time = end_time = last_time = 0;
+
+    CTraceHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+    h.version = TRACE_VERSION;
+    h.datapath_w = DATAPATH_W;
+    h.n_signals = sig.size();
+    buf.clear();
+    buf.reserve(TRACE_BUF_SIZE + 64);
+    buf.insert(buf.end(), (uint8_t *)&h, (uint8_t *)(&h + 1));
+    buf.insert(buf.end(), (uint8_t *)sig.data(), (uint8_t *)(sig.data() + sig.size()));
+    return 0;
+}
+
+void CTraceWriter::close()
+{
+    if (!f)
+        return;
+    flush();
+    fclose(f);
+    f = NULL;
+}
+
+void CTraceWriter::flush()
+{
+    if (buf.size() && fwrite(buf.data(), 1, buf.size(), f) != buf.size())
+        printf("Cannot write trace\n");
+    buf.clear();
+}
+
+//LEB128
+void CTraceWriter::put(uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((uint8_t)v);
+}
+
+void CTraceWriter::sample(int cycle)
+{
+    uint64_t time = run_time + cycle;
+    end_time = time + 1;
+
+    int n = 0, n_slot = slot.size();
+    for (int i = 0; i < n_slot; i++)
+        n += *slot[i] != last[i];
+    if (n == 0)
+        return;
+
+    //at most 10 bytes per varint
+    if (buf.size() + 20 * (n + 1) > TRACE_BUF_SIZE)
+        flush();
+    put(time - last_time);
+    put(n);
+    last_time = time;
+    int prev = 0;
+    for (int i = 0; i < n_slot; i++)
+    {
+        versat_t v = *slot[i];
+        if (v == last[i])
+            continue;
+        int64_t d = (int64_t)v - (int64_t)last[i];
+        put(i - prev);
+        put(((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+        prev = i;
+        last[i] = v;
+    }
+}
+
+int CTraceReader::open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    data.clear();
+    uint8_t chunk[TRACE_BUF_SIZE];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(f);
+
+    CTraceHeader h;
+    memset(&h, 0, sizeof(h));
+    if (data.size() >= sizeof(h))
+        memcpy(&h, data.data(), sizeof(h));
+    if (memcmp(h.magic, TRACE_MAGIC, sizeof(h.magic)) || h.version != TRACE_VERSION ||
+        data.size() < sizeof(h) + (size_t)h.n_signals * sizeof(CTraceSignal))
+    {
+        printf("Not a Versat trace: %s\n", path);
+        return -1;
+    }
+    signals.resize(h.n_signals);
+    memcpy(signals.data(), data.data() + sizeof(h), h.n_signals * sizeof(CTraceSignal));
+    values.assign(h.n_signals, 0);
+    pos = sizeof(h) + h.n_signals * sizeof(CTraceSignal);
+    last_time = 0;
+    return 0;
+}
+
+//LEB128, 0 past the end of a truncated trace
+uint64_t CTraceReader::get(size_t &p)
+{
+    uint64_t v = 0;
+    for (int shift = 0; p < data.size() && shift < 64; shift += 7)
+    {
+        uint8_t b = data[p++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (b < 0x80)
+            break;
+    }
+    return v;
+}
+
+const std::vector<versat_t> &CTraceReader::at(uint64_t time)
+{
+    while (pos < data.size())
+    {
+        //apply the next record if it is not past time
+        size_t p = pos;
+        uint64_t t = last_time + get(p);
+        if (t > time)
+            break;
+        uint64_t n = get(p), i = 0;
+        for (uint64_t c = 0; c < n; c++)
+        {
+            i += get(p);
+            uint64_t z = get(p);
+            if (i < values.size())
+                values[i] = (versat_t)((int64_t)values[i] + (int64_t)((z >> 1) ^ -(z & 1)));
+        }
+        pos = p;
+        last_time = t;
+    }
+    return values;
+}
+VERSAT_NS_END
@@ -0,0 +1,103 @@
+#ifndef VERSAT_TRACE_HPP
+#define VERSAT_TRACE_HPP
+#include "type.hpp"
+#include <stdio.h>
+#include <vector>
+
+VERSAT_NS_BEGIN
+
+//
+// Cycle trace
+// Binary log of the FU outputs, the stage databus slots, cycle by cycle.
+// A header lists the traced signals, then one record per cycle with
+// changes holds, as LEB128 varints:
+//   time - time of the previous record (first record: time)
+//   number of changed signals
+//   per change: signal - previous changed signal (first: signal)
+//               zigzag(value - previous value of the signal)
+// All signals are 0 before the first record. Time counts the traced
+// cycles, each run starts after the last traced cycle of the one before.
+// python/trace2vcd.py converts a trace to VCD, CTraceReader reads it back.
+//
+#define TRACE_MAGIC "VERSATTR"
+#define TRACE_VERSION 1
+#define TRACE_BUF_SIZE (1 << 16)
+
+//FU kinds traced, trace_open() fu_mask
+#define TRACE_MEM (1 << 0)
+#define TRACE_VI (1 << 1)
+#define TRACE_ALU (1 << 2)
+#define TRACE_ALULITE (1 << 3)
+#define TRACE_MUL (1 << 4)
+#define TRACE_MULADD (1 << 5)
+#define TRACE_BS (1 << 6)
+#define TRACE_ALL 0x7F
+
+struct CTraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t datapath_w;
+    uint32_t n_signals; //CTraceSignal entries following the header
+    uint32_t reserved;
+};
+
+struct CTraceSignal
+{
+    uint16_t stage, sel; //databus slot
+    char name[12];       //FU name, NUL padded
+};
+
+class CTraceWriter
+{
+public:
+    ~CTraceWriter() { close(); }
+
+    //trace the FUs of fu_mask in the stages set in stage_mask
+    //returns 0, or -1 if path cannot be created
+    int open(VersatInstance *versat, const char *path, uint64_t stage_mask, int fu_mask);
+    void close();
+
+    bool active() { return f != NULL; }
+
+    //a new run starts at the next traced cycle
+    void start_run() { run_time = end_time; }
+
+    //log the changes of run cycle cycle, after its update
+    void sample(int cycle);
+
+private:
+    FILE *f = NULL;
+    std::vector<versat_t *> slot;
+    std::vector<versat_t> last;
+    std::vector<uint8_t> buf;
+    uint64_t run_time = 0, end_time = 0, last_time = 0;
+
+    void put(uint64_t v);
+    void add(std::vector<CTraceSignal> &sig, VersatInstance *versat, int s, int sel, const char *name, int i);
+    void flush();
+};
+
+//reads back a trace, the values of its signals cycle by cycle
+class CTraceReader
+{
+public:
+    std::vector<CTraceSignal> signals;
+
+    //returns 0, or -1 if path cannot be read or is not a trace
+    int open(const char *path);
+
+    //values of the signals after traced cycle time, time must not decrease
+    //between calls
+    const std::vector<versat_t> &at(uint64_t time);
+
+private:
+    std::vector<uint8_t> data;
+    std::vector<versat_t> values;
+    size_t pos = 0;
+    uint64_t last_time = 0;
+
+    uint64_t get(size_t &p);
+};
+VERSAT_NS_END
+#endif
@@ -1,7 +1,28 @@
+#ifndef VERSAT_TYPE_HPP
+#define VERSAT_TYPE_HPP
 #include "versat.h"
 #include <iostream>
 #include <bitset>
 
+using namespace std;
+
+//
+// Simulator namespace
+// Building the simulator with -DVERSAT_NAMESPACE=<name> puts all of it,
+// versat_t included, in namespace <name>. Builds of different versat.h
+// (topologies, datapath widths) then link into one binary side by side,
+// each driven from translation units that include its own versat.h.
+//
+#ifdef VERSAT_NAMESPACE
+#define VERSAT_NS_BEGIN namespace VERSAT_NAMESPACE {
+#define VERSAT_NS_END }
+#else
+#define VERSAT_NS_BEGIN
+#define VERSAT_NS_END
+#endif
+
+VERSAT_NS_BEGIN
+
 #if DATAPATH_W == 16
 typedef int16_t versat_t;
 typedef int32_t mul_t;
@@ -17,7 +38,8 @@ typedef uint64_t shift_t;
 
 #endif
 
-using namespace std;
+//simulated versat owning the FUs
+class VersatInstance;
 
 #define SET_BITS(var, val, size)   \
     for (int i = 0; i < size; i++) \
@@ -41,7 +63,15 @@ using namespace std;
 
 //constants
 #define CONF_BASE (1 << (nMEM_W + MEM_ADDR_W + 1))
-#define CONF_MEM_SIZE ((int)pow(2, CONF_MEM_ADDR_W))
+#define CONF_MEM_SIZE (1 << CONF_MEM_ADDR_W)
+//conf_mem access cycles (xconf_mem.v): a store is one write, a restore
+//is the read plus the load of the config register one cycle later
+#define CONF_MEM_WR_CYCLES 1
+#define CONF_MEM_RD_CYCLES 2
+//writes to reprogram a full stage config through the config registers
+#define CONF_REG_FIELDS (CONF_BS0 + nBS * BS_CONF_OFFSET)
 //#define MEM_SIZE ((int)pow(2,MEM_ADDR_W))
 #define MEM_SIZE (1 << MEM_ADDR_W)
-#define RUN_DONE (1 << (nMEM_W + MEM_ADDR_W))
\ No newline at end of file
+#define RUN_DONE (1 << (nMEM_W + MEM_ADDR_W))
+VERSAT_NS_END
+#endif
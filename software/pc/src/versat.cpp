@@ -1,17 +1,65 @@
 #include "versat.hpp"
-#include <pthread.h>
-void versat_init(int base_addr)
+#include <chrono>
+
+VERSAT_NS_BEGIN
+
+//queued run: snapshot of the configuration at run() time
+struct CRunRequest
+{
+    CStage conf[nSTAGE];
+    std::function<void()> callback;
+    bool resume = 0; //continue the paused run, conf is not used
+};
+
+VersatInstance::VersatInstance(int base_addr) : run_done(0)
+{
+    init(base_addr);
+    //memories start cleared, as those of versat_default, also in instances
+    //created on the heap
+    memset((void *)versat_mem, 0, sizeof(versat_mem));
+#if nVI > 0
+    memset((void *)vi_mem, 0, sizeof(vi_mem));
+#endif
+#if nVO > 0
+    memset((void *)vo_mem, 0, sizeof(vo_mem));
+#endif
+}
+
+VersatInstance::~VersatInstance()
+{
+    //finish queued runs and stop worker
+    if (run_worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(run_mutex);
+            run_exit = true;
+        }
+        run_cv.notify_all();
+        run_worker.join();
+    }
+    sim_pool_stop();
+}
+
+void VersatInstance::init(int base_addr)
 {
 
     //init versat stages
     int i;
     base_addr = 0;
     base = base_addr;
+    ring_copy = topo.n_stage * (1 << (N_W - 1));
     for (i = 0; i < nSTAGE; i++)
     {
-        stage[i] = CStage(base_addr + i);
-        shadow_reg[i] = CStage(base_addr + i);
+        stage[i] = CStage(this, base_addr + i);
+        shadow_reg[i] = CStage(this, base_addr + i);
+#ifdef CONF_MEM_USE
+        for (int j = 0; j < CONF_MEM_SIZE; j++)
+            conf_mem[i][j] = CStage(this, base_addr + i);
+#endif
     }
+#ifdef CONF_MEM_USE
+    conf_mem_cycles = 0;
+#endif
     //prepare sel variables
     int p_offset = (1 << (N_W - 1));
     int s_cnt = 0;
@@ -26,6 +74,15 @@ void versat_init(int base_addr)
     }
     s_cnt += 2 * nMEM;
 #endif
+#if nVI > 0
+    //Vector inputs
+    for (i = 0; i < nVI; i = i + 1)
+    {
+        sVI[i] = s_cnt + i;
+        sVI_p[i] = sVI[i] + p_offset;
+    }
+    s_cnt += nVI;
+#endif
 #if nALU > 0
     //ALUs
     for (i = 0; i < nALU; i = i + 1)
@@ -76,108 +133,905 @@ void versat_init(int base_addr)
 #endif
 }
 
-int versat_iter = 0;
-void *run_sim(void *ie)
+void *VersatInstance::run_sim(bool resume)
 {
     int i = 0;
     //put simulation here
     bool run_mem = 0;
     bool run_mem_stage[nSTAGE] = {0};
     bool aux;
-    //set run start for all FUs
+    if (resume)
+    {
+        //FU state was kept, rebuild the FU lists at the run cycle:
+        //ports and MulAdds past their delay are woken on the first cycle
+        build_active_FUs();
+        for (i = 0; i < nSTAGE; i++)
+            shadow_reg[i].cycle = versat_iter;
+    }
+    else
+    {
+        drop_absent_FUs();
+        //set run start for all FUs
+        for (i = 0; i < nSTAGE; i++)
+        {
+            shadow_reg[i].start_all_FUs();
+        }
+        build_active_FUs();
+        if (trace.active())
+            trace.start_run();
+    }
+    //run cycle to pause at, -1 if none
+    //(versat_iter counts the cycles of the current run)
+    int stop = run_break > versat_iter ? run_break : -1;
+
+    if (engine == VERSAT_ENGINE_SOA)
+        run_sim_soa(stop);
+    else if (engine == VERSAT_ENGINE_COMPILED)
+    {
+        compiled.compile(this);
+        versat_iter += compiled.run(versat_iter, stop);
+    }
+    else if (sim_threads > 1)
+    {
+        //parallel run: this thread simulates the first block of stages
+        {
+            std::lock_guard<std::mutex> lock(sim_mutex);
+            sim_cycles = stop < 0 ? -1 : stop - versat_iter;
+            sim_gen++;
+        }
+        sim_cv.notify_all();
+        run_sim_stages(0, stop < 0 ? -1 : stop - versat_iter);
+    }
+    else
+    {
+        //main run loop
+        while (!run_mem && versat_iter != stop)
+        {
+            //only start delays counting down: jump to the next wake
+            int idle = idle_cycles(stop);
+            if (idle > 0)
+            {
+                for (i = 0; i < nSTAGE; i++)
+                    shadow_reg[i].cycle += idle;
+                versat_iter += idle;
+                //nothing changed, only the trace end moves
+                if (trace.active())
+                    trace.sample(versat_iter - 1);
+                continue;
+            }
+
+            //calculate new outputs
+            for (i = 0; i < nSTAGE; i++)
+            {
+                shadow_reg[i].output_all_FUs();
+            }
+
+            //update output buffers and datapath
+            for (i = 0; i < nSTAGE; i++)
+            {
+                shadow_reg[i].update_all_FUs();
+            }
+            //TO DO: check for run finish
+            //set run_done to 0
+            for (i = 0; i < nSTAGE; i++)
+            {
+                run_mem_stage[i] = shadow_reg[i].done();
+            }
+            aux = run_mem_stage[0];
+            for (i = 1; i < nSTAGE; i++)
+            {
+                aux = aux && run_mem_stage[i];
+            }
+            run_mem = aux;
+            if (trace.active())
+                trace.sample(versat_iter);
+            versat_iter++;
+        }
+    }
+
+    //stopped at the break before all stages are done
+    run_paused = 0;
     for (i = 0; i < nSTAGE; i++)
+        run_paused = run_paused || !shadow_reg[i].done();
+    return NULL;
+}
+
+//mark the FU driving selector sel of stage s as live
+void VersatInstance::need_sel(int s, int sel, bool (*live)[1 << (N_W - 1)], int *work, int &n_work)
+{
+    int half = 1 << (N_W - 1);
+    if (sel < 0 || sel >= 2 * half)
+        return;
+    //upper half selects the previous stage of the ring
+    if (sel >= half)
     {
-        shadow_reg[i].start_all_FUs();
+        s = (s - 1 + topo.n_stage) % topo.n_stage;
+        sel -= half;
     }
+    //FUs of topo only
+    if (sel_to_hw(sel) < 0)
+        return;
+    if (live[s][sel])
+        return;
+    live[s][sel] = 1;
+    work[n_work++] = s * half + sel;
+}
+
+//build the FU lists evaluated by each stage in this run
+//mem ports are always simulated, but wait out their delay off the list
+//and are dropped once done with a drained output FIFO
+//compute FUs are simulated only when their output reaches a writing mem
+//port, directly or through other FUs; skipped FUs keep the pipeline state
+//of the last run they were live in
+//a traced run simulates all the FUs of topo, so every traced slot holds the
+//value the RTL computes instead of a stale one
+void VersatInstance::build_active_FUs()
+{
+    int half = 1 << (N_W - 1);
+    static thread_local bool live[nSTAGE][1 << (N_W - 1)];
+    static thread_local int work[nSTAGE * (1 << (N_W - 1))];
+    int n_work = 0;
+    int s, j;
+
+    memset(live, 0, sizeof(live));
+
+    //roots: data inputs of writing mem ports
+    for (s = 0; s < topo.n_stage; s++)
+        for (j = 0; j < 2 * nMEM; j++)
+            if (shadow_reg[s].mem_port(j).in_wr)
+                need_sel(s, shadow_reg[s].mem_port(j).sel, live, work, n_work);
+#if nVO > 0
+    //and of the VO
+    for (s = 0; s < topo.n_stage; s++)
+        for (j = 0; j < topo.n_vo; j++)
+            need_sel(s, shadow_reg[s].vo[j].port.sel, live, work, n_work);
+#endif
+    if (trace.active())
+        for (s = 0; s < topo.n_stage; s++)
+            for (j = 0; j < half; j++)
+                need_sel(s, j, live, work, n_work);
 
-    //main run loop
-    while (!run_mem)
+    //propagate to the inputs of live compute FUs
+    while (n_work > 0)
     {
+        n_work--;
+        s = work[n_work] / half;
+        int slot = work[n_work] % half;
+        CStage &st = shadow_reg[s];
+#if nALU > 0
+        if (slot >= sALU[0] && slot < sALU[0] + nALU)
+        {
+            need_sel(s, st.alu[slot - sALU[0]].opa, live, work, n_work);
+            need_sel(s, st.alu[slot - sALU[0]].opb, live, work, n_work);
+        }
+#endif
+#if nALULITE > 0
+        if (slot >= sALULITE[0] && slot < sALULITE[0] + nALULITE)
+        {
+            need_sel(s, st.alulite[slot - sALULITE[0]].opa, live, work, n_work);
+            need_sel(s, st.alulite[slot - sALULITE[0]].opb, live, work, n_work);
+        }
+#endif
+#if nMUL > 0
+        if (slot >= sMUL[0] && slot < sMUL[0] + nMUL)
+        {
+            need_sel(s, st.mul[slot - sMUL[0]].sela, live, work, n_work);
+            need_sel(s, st.mul[slot - sMUL[0]].selb, live, work, n_work);
+        }
+#endif
+#if nMULADD > 0
+        if (slot >= sMULADD[0] && slot < sMULADD[0] + nMULADD)
+        {
+            need_sel(s, st.muladd[slot - sMULADD[0]].sela, live, work, n_work);
+            need_sel(s, st.muladd[slot - sMULADD[0]].selb, live, work, n_work);
+        }
+#endif
+#if nBS > 0
+        if (slot >= sBS[0] && slot < sBS[0] + nBS)
+            need_sel(s, st.bs[slot - sBS[0]].data, live, work, n_work);
+#endif
+    }
 
-        //calculate new outputs
-        for (i = 0; i < nSTAGE; i++)
+    for (s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = shadow_reg[s];
+        st.cycle = 0;
+        st.n_active_mem = st.n_wait_mem = 0;
+        for (j = 0; j < 2 * nMEM; j++)
         {
-            shadow_reg[i].output_all_FUs();
+            if (st.mem_port(j).delay > 0)
+                st.wait_mem[st.n_wait_mem++] = j;
+            else
+                st.active_mem[st.n_active_mem++] = j;
         }
+#if nALU > 0
+        st.n_active_alu = 0;
+        for (j = 0; j < nALU; j++)
+            if (live[s][sALU[j]])
+                st.active_alu[st.n_active_alu++] = j;
+#endif
+#if nALULITE > 0
+        st.n_active_alulite = 0;
+        for (j = 0; j < nALULITE; j++)
+            if (live[s][sALULITE[j]])
+                st.active_alulite[st.n_active_alulite++] = j;
+#endif
+#if nBS > 0
+        st.n_active_bs = 0;
+        for (j = 0; j < nBS; j++)
+            if (live[s][sBS[j]])
+                st.active_bs[st.n_active_bs++] = j;
+#endif
+#if nMUL > 0
+        st.n_active_mul = 0;
+        for (j = 0; j < nMUL; j++)
+            if (live[s][sMUL[j]])
+                st.active_mul[st.n_active_mul++] = j;
+#endif
+#if nMULADD > 0
+        st.n_active_muladd = st.n_wait_muladd = 0;
+        for (j = 0; j < nMULADD; j++)
+        {
+            if (!live[s][sMULADD[j]])
+                continue;
+            if (st.muladd[j].delay > 0)
+                st.wait_muladd[st.n_wait_muladd++] = j;
+            else
+                st.active_muladd[st.n_active_muladd++] = j;
+        }
+#endif
+    }
+}
+
+//cycles the serial run loop can skip from versat_iter: until the next
+//wake of a mem port or MulAdd, or stop, when no port, VI/VO or MulAdd is
+//running and every live compute FU is steady, so that the databus and
+//all FU state hold until the wake; 0 otherwise
+int VersatInstance::idle_cycles(int stop)
+{
+    int s, j, wake = -1;
+    if (topo.n_vi + topo.n_vo > 0)
+        return 0;
+    for (s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = shadow_reg[s];
+        if (st.n_active_mem > 0)
+            return 0;
+        for (j = 0; j < st.n_wait_mem; j++)
+            if (wake < 0 || st.mem_port(st.wait_mem[j]).delay < wake)
+                wake = st.mem_port(st.wait_mem[j]).delay;
+#if nMULADD > 0
+        if (st.n_active_muladd > 0)
+            return 0;
+        for (j = 0; j < st.n_wait_muladd; j++)
+            if (wake < 0 || st.muladd[st.wait_muladd[j]].delay < wake)
+                wake = st.muladd[st.wait_muladd[j]].delay;
+#endif
+    }
+    //all done: the run ends this cycle
+    if (wake < 0)
+        return 0;
+    for (s = 0; s < nSTAGE; s++)
+    {
+        CStage &st = shadow_reg[s];
+#if nALU > 0
+        for (j = 0; j < st.n_active_alu; j++)
+            if (!st.alu[st.active_alu[j]].steady())
+                return 0;
+#endif
+#if nALULITE > 0
+        for (j = 0; j < st.n_active_alulite; j++)
+            if (!st.alulite[st.active_alulite[j]].steady())
+                return 0;
+#endif
+#if nBS > 0
+        for (j = 0; j < st.n_active_bs; j++)
+            if (!st.bs[st.active_bs[j]].steady())
+                return 0;
+#endif
+#if nMUL > 0
+        for (j = 0; j < st.n_active_mul; j++)
+            if (!st.mul[st.active_mul[j]].steady())
+                return 0;
+#endif
+    }
+    int idle = wake - shadow_reg[0].cycle;
+    if (stop >= 0 && idle > stop - versat_iter)
+        idle = stop - versat_iter;
+    return idle > 0 ? idle : 0;
+}
+
+//FUs outside topo have no configuration registers: back to reset,
+//so their ports are done at once and nothing reads them
+void VersatInstance::drop_absent_FUs()
+{
+    int s, j;
+    for (s = topo.n_stage; s < nSTAGE; s++)
+        shadow_reg[s] = CStage(this, s);
+    for (s = 0; s < topo.n_stage; s++)
+    {
+        CStage &st = shadow_reg[s];
+        for (j = topo.n_mem; j < nMEM; j++)
+        {
+            st.memA[j] = CMemPort(this, s, j, 0, st.databus);
+            st.memB[j] = CMemPort(this, s, j, 1, st.databus);
+        }
+#if nVI > 0
+        for (j = topo.n_vi; j < nVI; j++)
+            st.vi[j] = CVI(this, s, j, st.databus);
+#endif
+#if nVO > 0
+        for (j = topo.n_vo; j < nVO; j++)
+            st.vo[j] = CVO(this, s, j, st.databus);
+#endif
+    }
+}
+
+//run loop of the SoA engine: mem ports are simulated by the stages,
+//the compute FUs by soa, with the same output/update phases
+//(versat_iter is the run cycle)
+void VersatInstance::run_sim_soa(int stop)
+{
+    int i;
+    bool run_mem = 0;
+
+    soa.load(this);
+    while (!run_mem && versat_iter != stop)
+    {
+        //calculate new outputs
+        for (i = 0; i < nSTAGE; i++)
+            shadow_reg[i].output_mem_ports();
+        soa.output(versat_iter);
 
         //update output buffers and datapath
         for (i = 0; i < nSTAGE; i++)
+            shadow_reg[i].update_mem_ports();
+        soa.update(versat_iter);
+
+        run_mem = 1;
+        for (i = 0; i < nSTAGE; i++)
+            run_mem = run_mem && shadow_reg[i].done();
+        if (trace.active())
+            trace.sample(versat_iter);
+        versat_iter++;
+    }
+    soa.store(versat_iter);
+}
+
+//simulate block t of stages in lock step with the other simulation threads
+//outputs only read the databus and updates only write each stage's own
+//slice, so a barrier between the two phases keeps the run cycle exact
+void VersatInstance::run_sim_stages(int t, int cycles)
+{
+    int i;
+    int lo = t * nSTAGE / sim_threads;
+    int hi = (t + 1) * nSTAGE / sim_threads;
+    bool sense = sim_barrier.get_sense();
+    bool run_mem = 0;
+
+    //every thread stops after the same number of cycles at a break
+    for (int n = 0; !run_mem && n != cycles; n++)
+    {
+        //calculate new outputs
+        for (i = lo; i < hi; i++)
+            shadow_reg[i].output_all_FUs();
+        sim_barrier.wait(sense);
+
+        //update output buffers and datapath
+        for (i = lo; i < hi; i++)
         {
             shadow_reg[i].update_all_FUs();
+            stage_done[i] = shadow_reg[i].done();
         }
-        //TO DO: check for run finish
-        //set run_done to 0
+        sim_barrier.wait(sense);
+
+        //every thread checks for run finish
+        run_mem = 1;
         for (i = 0; i < nSTAGE; i++)
+            run_mem = run_mem && stage_done[i];
+        //the others only read the databus until the next barrier
+        if (t == 0)
         {
-            run_mem_stage[i] = shadow_reg[i].done();
+            if (trace.active())
+                trace.sample(versat_iter);
+            versat_iter++;
         }
-        aux = run_mem_stage[0];
-        for (i = 1; i < nSTAGE; i++)
+    }
+}
+
+void VersatInstance::set_engine(int engine)
+{
+    //no run may be in progress while the engine changes
+    wait();
+    this->engine = engine;
+}
+
+void VersatInstance::set_run_break(int cycle)
+{
+    wait();
+    run_break = cycle;
+}
+
+int VersatInstance::paused()
+{
+    wait();
+    return run_paused;
+}
+
+int VersatInstance::trace_open(const char *path, uint64_t stage_mask, int fu_mask)
+{
+    //no run may be sampling the old trace
+    wait();
+    return trace.open(this, path, stage_mask, fu_mask);
+}
+
+void VersatInstance::trace_close()
+{
+    wait();
+    trace.close();
+}
+
+void VersatInstance::set_ext_mem(versat_t *mem, uint32_t size)
+{
+    //no run may be using the old memory
+    wait();
+    ext_mem = mem;
+    ext_mem_size = size;
+}
+
+versat_t VersatInstance::ext_read(uint32_t addr)
+{
+    if (addr >= ext_mem_size)
+    {
+        printf("Invalid EXT READ ADDR=%u\n", addr);
+        return 0;
+    }
+    return ext_mem[addr];
+}
+
+void VersatInstance::ext_write(uint32_t addr, versat_t data)
+{
+    if (addr >= ext_mem_size)
+        printf("Invalid EXT WRITE ADDR=%u\n", addr);
+    else
+        ext_mem[addr] = data;
+}
+
+//simulation helper thread: runs block t of every parallel run after gen
+void VersatInstance::sim_helper(int t, unsigned gen)
+{
+    std::unique_lock<std::mutex> lock(sim_mutex);
+    while (true)
+    {
+        sim_cv.wait(lock, [&] { return sim_exit || sim_gen != gen; });
+        if (sim_exit)
+            return;
+        gen = sim_gen;
+        //read under the lock, the next run may change it
+        int cycles = sim_cycles;
+        lock.unlock();
+        run_sim_stages(t, cycles);
+        lock.lock();
+    }
+}
+
+void VersatInstance::sim_pool_stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(sim_mutex);
+        sim_exit = true;
+    }
+    sim_cv.notify_all();
+    for (auto &th : sim_pool)
+        th.join();
+    sim_pool.clear();
+    sim_exit = false;
+}
+
+void VersatInstance::set_sim_threads(int n)
+{
+    //no run may be in progress while the pool changes
+    wait();
+    sim_pool_stop();
+
+    if (n > nSTAGE)
+        n = nSTAGE;
+    if (n < 1)
+        n = 1;
+    sim_threads = n;
+    sim_barrier.init(n);
+    {
+        std::lock_guard<std::mutex> lock(sim_mutex);
+        for (int t = 1; t < n; t++)
+            sim_pool.push_back(std::thread(&VersatInstance::sim_helper, this, t, sim_gen));
+    }
+}
+
+//simulation worker: executes queued runs back to back
+void VersatInstance::run_loop()
+{
+    std::unique_lock<std::mutex> lock(run_mutex);
+    while (true)
+    {
+        run_cv.wait(lock, [this] { return run_exit || !run_queue.empty(); });
+        if (run_queue.empty())
+            return;
+        CRunRequest *req = run_queue.front();
+        run_queue.pop_front();
+        lock.unlock();
+
+        if (!req->resume)
         {
-            aux = aux && run_mem_stage[i];
+            //update shadow register with queued configuration
+            for (int i = 0; i < nSTAGE; i++)
+            {
+                shadow_reg[i].reset();
+                shadow_reg[i].copy(req->conf[i]);
+            }
+            versat_iter = 0;
+            run_sim();
         }
-        run_mem = aux;
-        versat_iter++;
+        else if (run_paused)
+            run_sim(true);
+        if (req->callback)
+            req->callback();
+        delete req;
+
+        lock.lock();
+        if (--run_pending == 0)
+            run_done.store(1, std::memory_order_release);
+        run_cv.notify_all();
     }
-    run_done = 1;
-    return NULL;
 }
 
-pthread_t t;
-void run()
+void VersatInstance::run()
+{
+    run(std::function<void()>());
+}
+
+void VersatInstance::run(std::function<void()> callback)
 {
     //MEMSET(base, (RUN_DONE), 1);
-    int i = 0;
-    run_done = 0;
-    versat_iter = 0;
+    CRunRequest *req = new CRunRequest;
+    for (int i = 0; i < nSTAGE; i++)
+        req->conf[i] = stage[i];
+    req->callback = callback;
+    queue_run(req);
+}
 
-    //update shadow register with current configuration
-    for (i = 0; i < nSTAGE; i++)
+void VersatInstance::resume()
+{
+    CRunRequest *req = new CRunRequest;
+    req->resume = 1;
+    queue_run(req);
+}
+
+void VersatInstance::queue_run(CRunRequest *req)
+{
     {
-        stage[i].reset();
-        shadow_reg[i].copy(stage[i]);
+        std::lock_guard<std::mutex> lock(run_mutex);
+        run_queue.push_back(req);
+        run_pending++;
+        run_done.store(0, std::memory_order_relaxed);
+        //start worker on first run
+        if (!run_worker.joinable())
+            run_worker = std::thread(&VersatInstance::run_loop, this);
     }
+    run_cv.notify_all();
+}
 
-    pthread_create(&t, NULL, run_sim, NULL);
+std::future<int> VersatInstance::run_async()
+{
+    auto p = std::make_shared<std::promise<int>>();
+    std::future<int> f = p->get_future();
+    run([this, p]() { p->set_value(versat_iter); });
+    return f;
 }
 
-int done()
+int VersatInstance::done()
 {
-    return run_done;
+    return run_done.load(std::memory_order_acquire);
 }
 
-void globalClearConf()
+void VersatInstance::wait()
 {
+    std::unique_lock<std::mutex> lock(run_mutex);
+    run_cv.wait(lock, [this] { return run_pending == 0; });
+}
+
+int VersatInstance::wait_for(int timeout_us)
+{
+    std::unique_lock<std::mutex> lock(run_mutex);
+    run_cv.wait_for(lock, std::chrono::microseconds(timeout_us),
+                    [this] { return run_pending == 0; });
+    return done();
+}
+
+int VersatInstance::run_batch(CBatchRun &batch)
+{
+    if (batch.instance() != this)
+    {
+        printf("Invalid batch run: batch of another instance\n");
+        return -1;
+    }
+    if (topo.n_vi + topo.n_vo > 0)
+    {
+        printf("Invalid batch run: VI/VO are not batched\n");
+        return -1;
+    }
+    wait();
+    //a new run, as in run_loop(): configuration to shadow register
+    //(the shadow databus is left alone, the lanes have their own)
     for (int i = 0; i < nSTAGE; i++)
+        shadow_reg[i].copy(stage[i]);
+    drop_absent_FUs();
+    for (int i = 0; i < nSTAGE; i++)
+        shadow_reg[i].start_all_FUs();
+    build_active_FUs();
+    run_paused = 0;
+    versat_iter = batch.run();
+    return versat_iter;
+}
+
+void VersatInstance::globalClearConf()
+{
+    wait();
+    for (int i = 0; i < nSTAGE; i++)
+    {
+        shadow_reg[i] = CStage(this, i);
+        stage[i] = CStage(this, i);
+    }
+    //FUs are back to reset, so is the databus they drive
+    memset(global_databus, 0, sizeof(global_databus));
+}
+
+int VersatInstance::set_topology(const CTopology &t)
+{
+    if (!topology_fits(t))
+        return -1;
+    wait();
+    topo = t;
+    //new ring: databus pointers of all stages
+    init(base);
+    globalClearConf();
+    memset((void *)versat_mem, 0, sizeof(versat_mem));
+#if nVI > 0
+    memset((void *)vi_mem, 0, sizeof(vi_mem));
+#endif
+#if nVO > 0
+    memset((void *)vo_mem, 0, sizeof(vo_mem));
+#endif
+    return 0;
+}
+
+int VersatInstance::load_topology(const char *path)
+{
+    CTopology t;
+    if (read_topology(path, t))
+        return -1;
+    return set_topology(t);
+}
+
+int VersatInstance::databus_block(int s)
+{
+    int n = topo.n_stage;
+    return (1 << (N_W - 1)) * (s == 0 ? 0 : s < n ? n - s : s + 1);
+}
+
+//translate sel between the envelope numbering and the one of topo,
+//same FU order (MEM A/B, VI, ALU, ALULITE, MUL, MULADD, BS) in both
+int VersatInstance::map_sel(int sel, bool to_hw)
+{
+    const int n_env[] = {2 * nMEM, nVI, nALU, nALULITE, nMUL, nMULADD, nBS};
+    const int n_hw[] = {2 * topo.n_mem, topo.n_vi, topo.n_alu, topo.n_alulite,
+                        topo.n_mul, topo.n_muladd, topo.n_bs};
+    int n = 0;
+    for (int k = 0; k < 7; k++)
+        n += n_hw[k];
+    int half = 1 << (N_W - 1), hw_half = 1 << clog2(n);
+    const int *from = to_hw ? n_env : n_hw, *to = to_hw ? n_hw : n_env;
+    int from_half = to_hw ? half : hw_half, to_half = to_hw ? hw_half : half;
+    int prev = 0;
+
+    if (sel < 0 || sel >= 2 * from_half)
+        return -1;
+    //upper half selects the previous stage
+    if (sel >= from_half)
     {
-        shadow_reg[i] = CStage(i);
-        stage[i] = CStage(i);
+        sel -= from_half;
+        prev = to_half;
     }
+    for (int k = 0, f = 0, t = 0; k < 7; f += from[k], t += to[k], k++)
+        if (sel < f + from[k])
+            return sel - f < n_hw[k] ? prev + t + sel - f : -1;
+    return -1;
 }
 
-versat_t global_databus[(nSTAGE + 1) * (1 << (N_W - 1))];
+int VersatInstance::sel_to_hw(int sel)
+{
+    return map_sel(sel, 1);
+}
+
+int VersatInstance::sel_from_hw(int hw)
+{
+    return map_sel(hw, 0);
+}
+
+//
+//default instance
+//
+VersatInstance versat_default;
+
+int &base = versat_default.base;
+CStage (&stage)[nSTAGE] = versat_default.stage;
+CStage (&shadow_reg)[nSTAGE] = versat_default.shadow_reg;
+CMem (&versat_mem)[nSTAGE][nMEM] = versat_default.versat_mem;
+int &versat_iter = versat_default.versat_iter;
+std::atomic<int> &run_done = versat_default.run_done;
+versat_t (&global_databus)[(nSTAGE + 2) * (1 << (N_W - 1))] = versat_default.global_databus;
+#ifdef CONF_MEM_USE
+int &conf_mem_cycles = versat_default.conf_mem_cycles;
+#endif
 #if nMEM > 0
-int sMEMA[nMEM], sMEMA_p[nMEM], sMEMB[nMEM], sMEMB_p[nMEM];
+int (&sMEMA)[nMEM] = versat_default.sMEMA, (&sMEMA_p)[nMEM] = versat_default.sMEMA_p;
+int (&sMEMB)[nMEM] = versat_default.sMEMB, (&sMEMB_p)[nMEM] = versat_default.sMEMB_p;
+#endif
+#if nVI > 0
+int (&sVI)[nVI] = versat_default.sVI, (&sVI_p)[nVI] = versat_default.sVI_p;
 #endif
 #if nALU > 0
-int sALU[nALU], sALU_p[nALU];
+int (&sALU)[nALU] = versat_default.sALU, (&sALU_p)[nALU] = versat_default.sALU_p;
 #endif
 #if nALULITE > 0
-int sALULITE[nALULITE], sALULITE_p[nALULITE];
+int (&sALULITE)[nALULITE] = versat_default.sALULITE, (&sALULITE_p)[nALULITE] = versat_default.sALULITE_p;
 #endif
 #if nMUL > 0
-int sMUL[nMUL], sMUL_p[nMUL];
+int (&sMUL)[nMUL] = versat_default.sMUL, (&sMUL_p)[nMUL] = versat_default.sMUL_p;
 #endif
 #if nMULADD > 0
-int sMULADD[nMULADD], sMULADD_p[nMULADD];
+int (&sMULADD)[nMULADD] = versat_default.sMULADD, (&sMULADD_p)[nMULADD] = versat_default.sMULADD_p;
 #endif
-
 #if nBS > 0
-int sBS[nBS], sBS_p[nBS];
+int (&sBS)[nBS] = versat_default.sBS, (&sBS_p)[nBS] = versat_default.sBS_p;
 #endif
 
-int base;
-CStage stage[nSTAGE];
-CStage shadow_reg[nSTAGE];
-CMem versat_mem[nSTAGE][nMEM];
-int run_done = 0;
\ No newline at end of file
+void versat_init(int base_addr)
+{
+    versat_default.init(base_addr);
+}
+
+void run()
+{
+    versat_default.run();
+}
+
+void run(std::function<void()> callback)
+{
+    versat_default.run(callback);
+}
+
+std::future<int> run_async()
+{
+    return versat_default.run_async();
+}
+
+int done()
+{
+    return versat_default.done();
+}
+
+void wait()
+{
+    versat_default.wait();
+}
+
+int wait_for(int timeout_us)
+{
+    return versat_default.wait_for(timeout_us);
+}
+
+int run_batch(CBatchRun &batch)
+{
+    return versat_default.run_batch(batch);
+}
+
+void globalClearConf()
+{
+    versat_default.globalClearConf();
+}
+
+int load_topology(const char *path)
+{
+    return versat_default.load_topology(path);
+}
+
+void set_sim_threads(int n)
+{
+    versat_default.set_sim_threads(n);
+}
+
+void set_engine(int engine)
+{
+    versat_default.set_engine(engine);
+}
+
+void set_ext_mem(versat_t *mem, uint32_t size)
+{
+    versat_default.set_ext_mem(mem, size);
+}
+
+void set_run_break(int cycle)
+{
+    versat_default.set_run_break(cycle);
+}
+
+void resume()
+{
+    versat_default.resume();
+}
+
+int paused()
+{
+    return versat_default.paused();
+}
+
+int save_checkpoint(const char *path)
+{
+    return versat_default.save_checkpoint(path);
+}
+
+int load_checkpoint(const char *path)
+{
+    return versat_default.load_checkpoint(path);
+}
+
+int trace_open(const char *path, uint64_t stage_mask, int fu_mask)
+{
+    return versat_default.trace_open(path, stage_mask, fu_mask);
+}
+
+void trace_close()
+{
+    versat_default.trace_close();
+}
+
+CRunStats run_stats()
+{
+    return versat_default.run_stats();
+}
+
+int save_run_stats(const char *path)
+{
+    return versat_default.save_run_stats(path);
+}
+
+int save_mem_image(const char *path)
+{
+    return versat_default.save_mem_image(path);
+}
+
+int load_mem_image(const char *path)
+{
+    return versat_default.load_mem_image(path);
+}
+
+int save_mem_hex(int s, int m, const char *path)
+{
+    return versat_default.save_mem_hex(s, m, path);
+}
+
+int load_mem_hex(int s, int m, const char *path)
+{
+    return versat_default.load_mem_hex(s, m, path);
+}
+
+int save_conf(const char *path)
+{
+    return versat_default.save_conf(path);
+}
+
+int load_conf(const char *path)
+{
+    return versat_default.load_conf(path);
+}
+VERSAT_NS_END
@@ -2,10 +2,28 @@
 #define VERSAT_SIM
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <deque>
 #include "versat.h"
 #include <string.h>
 #include <bitset>
 #include "stage.hpp"
+#include "barrier.hpp"
+#include "soa.hpp"
+#include "compiled.hpp"
+#include "memimg.hpp"
+#include "checkpoint.hpp"
+#include "trace.hpp"
+#include "stats.hpp"
+#include "topology.hpp"
+#include "batch.hpp"
+#include <vector>
+
+VERSAT_NS_BEGIN
 
 //
 // VERSAT CLASSES
@@ -17,28 +35,362 @@ class CALULite;
 class CMul;
 class CMulAdd;
 class CStage;
+struct CRunRequest;
+
+//simulation engines
+#define VERSAT_ENGINE_OBJ 0 //one object per FU (reference)
+#define VERSAT_ENGINE_SOA 1 //compute FUs as vectorized arrays (soa.hpp)
+#define VERSAT_ENGINE_COMPILED 2 //configuration compiled to a step chain (compiled.hpp)
+
+//
+//VERSAT INSTANCE
+//owns all the state of one simulated Versat, so several
+//instances can be simulated in parallel in the same process
+//
+class VersatInstance
+{
+public:
+    int base = 0;
+    CStage stage[nSTAGE];
+    CStage shadow_reg[nSTAGE];
+    CMem versat_mem[nSTAGE][nMEM];
+#if nVI > 0
+    CMem vi_mem[nSTAGE][nVI];
+#endif
+#if nVO > 0
+    CMem vo_mem[nSTAGE][nVO];
+#endif
+    versat_t global_databus[(nSTAGE + 2) * (1 << (N_W - 1))] = {0};
+    /*databus vector
+    stage 0 is repeated in the start and at the end of the ring
+    of the topo.n_stage stages (n), the stages past it follow
+    stage order in databus
+    [ 0 | n-1 | n-2 | ... | 2  | 1 | 0 | n | ... | nSTAGE-1 | - ]
+    ^                              ^
+    |                              |
+    stage 0 databus                stage 1 databus
+
+    */
+
+    //runtime topology (topology.hpp), the build's by default
+    CTopology topo = compiled_topology();
+    //global databus index of the 2nd copy of stage 0
+    int ring_copy = nSTAGE * (1 << (N_W - 1));
+
+    //databus selectors
+#if nMEM > 0
+    int sMEMA[nMEM], sMEMA_p[nMEM], sMEMB[nMEM], sMEMB_p[nMEM];
+#endif
+#if nVI > 0
+    int sVI[nVI], sVI_p[nVI];
+#endif
+#if nALU > 0
+    int sALU[nALU], sALU_p[nALU];
+#endif
+#if nALULITE > 0
+    int sALULITE[nALULITE], sALULITE_p[nALULITE];
+#endif
+#if nMUL > 0
+    int sMUL[nMUL], sMUL_p[nMUL];
+#endif
+#if nMULADD > 0
+    int sMULADD[nMULADD], sMULADD_p[nMULADD];
+#endif
+#if nBS > 0
+    int sBS[nBS], sBS_p[nBS];
+#endif
+
+    int versat_iter = 0;
+    std::atomic<int> run_done;
+
+#ifdef CONF_MEM_USE
+    //configuration cache of each stage (xconf_mem.v)
+    CStage conf_mem[nSTAGE][CONF_MEM_SIZE];
+    //clock cycles spent in confMemWrite()/confMemRead()
+    int conf_mem_cycles = 0;
+#endif
+
+    //external memory seen by the VI/VO, NULL if none
+    //(owned by the caller, must outlive the runs that use it)
+    versat_t *ext_mem = NULL;
+    uint32_t ext_mem_size = 0;
+
+    VersatInstance(int base_addr = 0);
+    ~VersatInstance();
+    VersatInstance(const VersatInstance &) = delete;
+    VersatInstance &operator=(const VersatInstance &) = delete;
+
+    //init stages and selectors
+    void init(int base_addr);
+
+    //simulate the configuration in shadow_reg until all memories are done
+    //or the run break, resume continues a paused run
+    void *run_sim(bool resume = 0);
+
+    //queue a run of the current configuration
+    //(stage[] is copied, so it can be reconfigured while the run is pending)
+    void run();
+
+    //run and call callback from the simulation thread when the run finishes
+    void run(std::function<void()> callback);
+
+    //run and return a future holding the number of simulated clock cycles
+    std::future<int> run_async();
+
+    //1 when all queued runs have finished
+    int done();
+
+    //block until all queued runs finish
+    void wait();
+
+    //block until all queued runs finish or timeout_us expires
+    //returns done()
+    int wait_for(int timeout_us);
+
+    //run the current configuration on every lane of batch (batch.hpp), after
+    //the queued runs; the control state evolves as in a run(), the data of
+    //the instance (memories, databus, FU outputs) is not used
+    //returns the number of clock cycles, or -1 if batch is not of this
+    //instance or topo has VI/VO
+    int run_batch(CBatchRun &batch);
+
+    void globalClearConf();
+
+    //simulate topology t, or the one of the xversat.json at path
+    //configuration, memories and databus are cleared
+    //return 0, or -1 if the topology does not fit this build
+    int set_topology(const CTopology &t);
+    int load_topology(const char *path);
+
+    //global databus index of the databus of stage s
+    int databus_block(int s);
+
+    //selector sel of the envelope (sMEMA[] ...) in the databus numbering
+    //of topo, and back; -1 for FUs topo lacks
+    int sel_to_hw(int sel);
+    int sel_from_hw(int hw);
+
+    //words per memory in topo
+    int mem_size() { return 1 << topo.mem_addr_w; }
+
+    //number of threads simulating the stages of a run (1 = serial)
+    //stages are split in contiguous blocks, one per thread
+    void set_sim_threads(int n);
+
+    //simulation engine, VERSAT_ENGINE_OBJ, _SOA or _COMPILED
+    //the SoA and compiled engines are serial, sim_threads does not apply to them
+    void set_engine(int engine);
+
+    //set the external memory, size in words
+    void set_ext_mem(versat_t *mem, uint32_t size);
+
+    //external memory access of the VI/VO
+    versat_t ext_read(uint32_t addr);
+    void ext_write(uint32_t addr, versat_t data);
+
+    //dump/load all the stage memories as a binary image (memimg.hpp)
+    //return 0, or -1 if the file cannot be mapped or does not match
+    int save_mem_image(const char *path);
+    int load_mem_image(const char *path);
+
+    //dump/load versat_mem[s][m] in the $readmemh format of xmem.v
+    //return 0, or -1 on error
+    int save_mem_hex(int s, int m, const char *path);
+    int load_mem_hex(int s, int m, const char *path);
+
+    //configuration of all the stages (stage[]), stage 0 first, unpacked
+    //(nSTAGE CStageConf) or as the packed configuration registers of
+    //xconf_reg.v, conf_words() words per stage (confimg.hpp)
+    void get_conf(CStageConf *c);
+    void set_conf(const CStageConf *c);
+    std::vector<uint32_t> conf_bits();
+    //returns 0, or -1 if words is not the size of nSTAGE packed stages
+    int set_conf_bits(const uint32_t *bits, size_t words);
+
+    //save/load the packed configuration in a file
+    //return 0, or -1 if it cannot be written or does not match
+    int save_conf(const char *path);
+    int load_conf(const char *path);
+
+    //runs pause when they reach run cycle cycle (0: never)
+    //a paused run keeps its state until resume() or the next run()
+    void set_run_break(int cycle);
+
+    //queue the continuation of a paused run, to the end or the next break
+    void resume();
+
+    //1 if the last run is paused, waits for queued runs
+    int paused();
+
+    //checkpoint of the whole instance (checkpoint.hpp): configuration, FU
+    //and run state, memories and databus, at a run break or between runs
+    //the external memory is not included; both wait for queued runs
+    std::vector<char> checkpoint();
+    //returns 0, or -1 if data is not a checkpoint of this topology
+    int restore(const std::vector<char> &data);
+    int save_checkpoint(const char *path);
+    int load_checkpoint(const char *path);
+
+    //trace the outputs of the fu_mask FUs (TRACE_MEM, ...) of the stages
+    //set in stage_mask to path, for the runs until trace_close() (trace.hpp)
+    //returns 0, or -1 if path cannot be created
+    int trace_open(const char *path, uint64_t stage_mask = ~0ULL, int fu_mask = TRACE_ALL);
+    void trace_close();
+
+    //sampled by the engines at the end of every cycle when active
+    CTraceWriter trace;
+
+    //per-FU counters of the last run, at its end or break (stats.hpp)
+    //both wait for queued runs; save_run_stats() writes them as JSON
+    //and returns 0, or -1 if path cannot be created
+    CRunStats run_stats();
+    int save_run_stats(const char *path);
+
+private:
+    //run queue, executed back to back by a per-instance worker thread
+    std::mutex run_mutex;
+    std::condition_variable run_cv;
+    std::deque<CRunRequest *> run_queue;
+    int run_pending = 0;
+    bool run_exit = false;
+    std::thread run_worker;
+
+    void run_loop();
+    void queue_run(CRunRequest *req);
+
+    //pause/resume
+    int run_break = 0;
+    bool run_paused = 0;
+    int sim_cycles = -1; //cycles for the simulation threads, -1 until done
+    void state(CCheckpoint &c);
+
+    //parallel stage simulation
+    int sim_threads = 1;
+    std::vector<std::thread> sim_pool;
+    std::mutex sim_mutex;
+    std::condition_variable sim_cv;
+    unsigned sim_gen = 0;
+    bool sim_exit = false;
+    CBarrier sim_barrier;
+    bool stage_done[nSTAGE];
+
+    //FU liveness for the run in shadow_reg
+    void build_active_FUs();
+    void need_sel(int s, int sel, bool (*live)[1 << (N_W - 1)], int *work, int &n_work);
+    void drop_absent_FUs();
+    int idle_cycles(int stop);
+    int map_sel(int sel, bool to_hw);
+
+    //SoA engine
+    int engine = VERSAT_ENGINE_OBJ;
+    CSoAEngine soa;
+    void run_sim_soa(int stop);
+
+    //compiled engine
+    CCompiledRun compiled;
+
+    void sim_pool_stop();
+    void sim_helper(int t, unsigned gen);
+    void run_sim_stages(int t, int cycles);
+};
+
 //
 //VERSAT global variables
+//(aliases of the default instance used by the functions below)
 //
 #ifndef VERSAT_cpp // include guard
 #define VERSAT_cpp
 
+extern VersatInstance versat_default;
+extern int &base;
+extern CStage (&stage)[nSTAGE];
+extern CStage (&shadow_reg)[nSTAGE];
+extern CMem (&versat_mem)[nSTAGE][nMEM];
+extern int &versat_iter;
+extern std::atomic<int> &run_done;
+extern versat_t (&global_databus)[(nSTAGE + 2) * (1 << (N_W - 1))];
+#ifdef CONF_MEM_USE
+extern int &conf_mem_cycles;
+#endif
+#if nMEM > 0
+extern int (&sMEMA)[nMEM], (&sMEMA_p)[nMEM], (&sMEMB)[nMEM], (&sMEMB_p)[nMEM];
+#endif
+#if nVI > 0
+extern int (&sVI)[nVI], (&sVI_p)[nVI];
+#endif
+#if nALU > 0
+extern int (&sALU)[nALU], (&sALU_p)[nALU];
+#endif
+#if nALULITE > 0
+extern int (&sALULITE)[nALULITE], (&sALULITE_p)[nALULITE];
+#endif
+#if nMUL > 0
+extern int (&sMUL)[nMUL], (&sMUL_p)[nMUL];
+#endif
+#if nMULADD > 0
+extern int (&sMULADD)[nMULADD], (&sMULADD_p)[nMULADD];
+#endif
+#if nBS > 0
+extern int (&sBS)[nBS], (&sBS_p)[nBS];
+#endif
+
 //
 //VERSAT FUNCTIONS
+//(act on the default instance)
 //
 void versat_init(int base_addr);
 
-extern int run_done;
+//queue a run of the current configuration
+//(stage[] is copied, so it can be reconfigured while the run is pending)
+void run();
 
-void *run_sim();
+//run and call callback from the simulation thread when the run finishes
+void run(std::function<void()> callback);
 
-void run();
+//run and return a future holding the number of simulated clock cycles
+std::future<int> run_async();
 
+//1 when all queued runs have finished
 int done();
 
+//block until all queued runs finish
+void wait();
+
+//block until all queued runs finish or timeout_us expires
+//returns done()
+int wait_for(int timeout_us);
+
+int run_batch(CBatchRun &batch);
+
 void globalClearConf();
-#endif
 
+int load_topology(const char *path);
+
+void set_sim_threads(int n);
+
+void set_engine(int engine);
+
+void set_ext_mem(versat_t *mem, uint32_t size);
+
+int save_mem_image(const char *path);
+int load_mem_image(const char *path);
+int save_mem_hex(int s, int m, const char *path);
+int load_mem_hex(int s, int m, const char *path);
+
+int save_conf(const char *path);
+int load_conf(const char *path);
+
+void set_run_break(int cycle);
+void resume();
+int paused();
+int save_checkpoint(const char *path);
+int load_checkpoint(const char *path);
+
+int trace_open(const char *path, uint64_t stage_mask = ~0ULL, int fu_mask = TRACE_ALL);
+void trace_close();
+
+CRunStats run_stats();
+int save_run_stats(const char *path);
 #endif
 
 #define INFO 1
@@ -47,6 +399,7 @@ void globalClearConf();
 
 void print_versat_mems();
 void print_versat_info();
-void print_versat_iter();
 
 #endif
+VERSAT_NS_END
+#endif
@@ -0,0 +1,173 @@
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
+#if nVI > 0
+
+CVI::CVI()
+{
+}
+
+CVI::CVI(VersatInstance *versat, int versat_base, int i, versat_t *databus)
+{
+    this->versat = versat;
+    this->versat_base = versat_base;
+    this->vi_base = i;
+    CMem *mem = &versat->vi_mem[versat_base][i];
+    ext = CExtAddrGen(versat, mem, EXT2INT);
+    port = CMemPort(versat, versat_base, i, mem, versat->sVI, databus);
+    port.in_wr = 0;
+}
+
+void CVI::start_run()
+{
+    ext.start_run();
+    port.start_run();
+}
+
+void CVI::update()
+{
+    port.update();
+}
+
+versat_t CVI::output()
+{
+    //the port reads the memory before the external side writes it
+    port.output();
+    ext.output();
+    return 0;
+}
+
+void CVI::copy(CVI that)
+{
+    this->ext.copy(that.ext);
+    this->port.copy(that.port);
+    this->port.in_wr = 0;
+}
+
+void CVI::state(CCheckpoint &c)
+{
+    ext.state(c);
+    port.state(c);
+}
+
+void CVI::setExtAddr(int extAddr)
+{
+    ext.ext_addr = extAddr;
+}
+
+void CVI::setIntAddr(int intAddr)
+{
+    ext.int_addr = intAddr;
+}
+
+void CVI::setExtSize(int size)
+{
+    ext.size = size;
+}
+
+void CVI::setExtIter(int iter)
+{
+    ext.iter = iter;
+}
+
+void CVI::setExtPer(int per)
+{
+    ext.per = per;
+}
+
+void CVI::setExtDuty(int duty)
+{
+    ext.duty = duty;
+}
+
+void CVI::setExtShift(int shift)
+{
+    ext.shift = shift;
+}
+
+void CVI::setExtIncr(int incr)
+{
+    ext.incr = incr;
+}
+
+void CVI::setIntIter(int iter)
+{
+    port.setIter(iter);
+}
+
+void CVI::setIntPer(int per)
+{
+    port.setPer(per);
+}
+
+void CVI::setIntDuty(int duty)
+{
+    port.setDuty(duty);
+}
+
+void CVI::setIntStart(int start)
+{
+    port.setStart(start);
+}
+
+void CVI::setIntShift(int shift)
+{
+    port.setShift(shift);
+}
+
+void CVI::setIntIncr(int incr)
+{
+    port.setIncr(incr);
+}
+
+void CVI::setIntDelay(int delay)
+{
+    port.setDelay(delay);
+}
+
+void CVI::setIntRVRS(int rvrs)
+{
+    port.setRvrs(rvrs);
+}
+
+void CVI::setIntExt(int ext)
+{
+    port.setExt(ext);
+}
+
+void CVI::setIntIter2(int iter)
+{
+    port.setIter2(iter);
+}
+
+void CVI::setIntPer2(int per)
+{
+    port.setPer2(per);
+}
+
+void CVI::setIntShift2(int shift)
+{
+    port.setShift2(shift);
+}
+
+void CVI::setIntIncr2(int incr)
+{
+    port.setIncr2(incr);
+}
+
+string CVI::info()
+{
+    string ver = "vi[" + to_string(vi_base) + "]\n";
+    ver += ext.info();
+    ver += port.info();
+    return ver;
+}
+
+string CVI::info_iter()
+{
+    string ver = "vi[" + to_string(vi_base) + "]\n";
+    ver += port.info_iter();
+    return ver;
+}
+#endif
+VERSAT_NS_END
@@ -0,0 +1,178 @@
+#include "versat.hpp"
+
+VERSAT_NS_BEGIN
+#if nVO > 0
+
+CVO::CVO()
+{
+}
+
+CVO::CVO(VersatInstance *versat, int versat_base, int i, versat_t *databus)
+{
+    this->versat = versat;
+    this->versat_base = versat_base;
+    this->vo_base = i;
+    CMem *mem = &versat->vo_mem[versat_base][i];
+    ext = CExtAddrGen(versat, mem, INT2EXT);
+    port = CMemPort(versat, versat_base, i, mem, NULL, databus);
+    port.in_wr = 1;
+}
+
+void CVO::start_run()
+{
+    ext.start_run();
+    port.start_run();
+}
+
+void CVO::update()
+{
+    port.update();
+}
+
+versat_t CVO::output()
+{
+    //the external side reads the memory before the port writes it
+    ext.output();
+    port.output();
+    return 0;
+}
+
+void CVO::copy(CVO that)
+{
+    this->ext.copy(that.ext);
+    this->port.copy(that.port);
+    this->port.in_wr = 1;
+}
+
+void CVO::state(CCheckpoint &c)
+{
+    ext.state(c);
+    port.state(c);
+}
+
+void CVO::setExtAddr(int extAddr)
+{
+    ext.ext_addr = extAddr;
+}
+
+void CVO::setIntAddr(int intAddr)
+{
+    ext.int_addr = intAddr;
+}
+
+void CVO::setExtSize(int size)
+{
+    ext.size = size;
+}
+
+void CVO::setExtIter(int iter)
+{
+    ext.iter = iter;
+}
+
+void CVO::setExtPer(int per)
+{
+    ext.per = per;
+}
+
+void CVO::setExtDuty(int duty)
+{
+    ext.duty = duty;
+}
+
+void CVO::setExtShift(int shift)
+{
+    ext.shift = shift;
+}
+
+void CVO::setExtIncr(int incr)
+{
+    ext.incr = incr;
+}
+
+void CVO::setIntSel(int sel)
+{
+    port.setSel(sel);
+}
+
+void CVO::setIntIter(int iter)
+{
+    port.setIter(iter);
+}
+
+void CVO::setIntPer(int per)
+{
+    port.setPer(per);
+}
+
+void CVO::setIntDuty(int duty)
+{
+    port.setDuty(duty);
+}
+
+void CVO::setIntStart(int start)
+{
+    port.setStart(start);
+}
+
+void CVO::setIntShift(int shift)
+{
+    port.setShift(shift);
+}
+
+void CVO::setIntIncr(int incr)
+{
+    port.setIncr(incr);
+}
+
+void CVO::setIntDelay(int delay)
+{
+    port.setDelay(delay);
+}
+
+void CVO::setIntRVRS(int rvrs)
+{
+    port.setRvrs(rvrs);
+}
+
+void CVO::setIntExt(int ext)
+{
+    port.setExt(ext);
+}
+
+void CVO::setIntIter2(int iter)
+{
+    port.setIter2(iter);
+}
+
+void CVO::setIntPer2(int per)
+{
+    port.setPer2(per);
+}
+
+void CVO::setIntShift2(int shift)
+{
+    port.setShift2(shift);
+}
+
+void CVO::setIntIncr2(int incr)
+{
+    port.setIncr2(incr);
+}
+
+string CVO::info()
+{
+    string ver = "vo[" + to_string(vo_base) + "]\n";
+    ver += ext.info();
+    ver += port.info();
+    return ver;
+}
+
+string CVO::info_iter()
+{
+    string ver = "vo[" + to_string(vo_base) + "]\n";
+    ver += port.info_iter();
+    return ver;
+}
+#endif
+VERSAT_NS_END
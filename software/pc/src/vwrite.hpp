@@ -0,0 +1,72 @@
+#ifndef VERSAT_VWRITE_HPP
+#define VERSAT_VWRITE_HPP
+#include "type.hpp"
+#include "mem.hpp"
+#include "ext_addrgen.hpp"
+
+VERSAT_NS_BEGIN
+#if nVO > 0
+
+//
+// VO unit (vwrite.v): the internal side, a write port, stores a databus
+// value in the unit memory while the external side copies the memory to
+// the host external memory
+//
+class CVO
+{
+public:
+    VersatInstance *versat = NULL;
+    int versat_base, vo_base;
+    CExtAddrGen ext; //external side
+    CMemPort port;   //internal side
+
+    //Default constructor
+    CVO();
+    CVO(VersatInstance *versat, int versat_base, int i, versat_t *databus);
+
+    //start run
+    void start_run();
+
+    //update output buffer
+    void update();
+
+    versat_t output();
+
+    //both sides done
+    bool done() { return ext.done && port.done; }
+
+    void copy(CVO that);
+    //save/load configuration and state (checkpoint.hpp)
+    void state(CCheckpoint &c);
+
+    //Methods to set config parameters
+    void setExtAddr(int extAddr);
+    void setIntAddr(int intAddr);
+    void setExtSize(int size);
+    void setExtIter(int iter);
+    void setExtPer(int per);
+    void setExtDuty(int duty);
+    void setExtShift(int shift);
+    void setExtIncr(int incr);
+    void setIntSel(int sel);
+    void setIntIter(int iter);
+    void setIntPer(int per);
+    void setIntDuty(int duty);
+    void setIntStart(int start);
+    void setIntShift(int shift);
+    void setIntIncr(int incr);
+    void setIntDelay(int delay);
+    void setIntRVRS(int rvrs);
+    void setIntExt(int ext);
+    void setIntIter2(int iter);
+    void setIntPer2(int per);
+    void setIntShift2(int shift);
+    void setIntIncr2(int incr);
+
+    string info();
+    string info_iter();
+}; //end class CVO
+
+#endif
+VERSAT_NS_END
+#endif
@@ -17,7 +17,8 @@ int main(int argc, char **argv)
 
   //local variables
   int i, j, k, l, m;
-  int16_t pixels[25 * nSTAGE], weights[9 * nSTAGE], bias = 0, res;
+  versat_t pixels[25 * nSTAGE], weights[9 * nSTAGE], bias = 0;
+  int16_t res;
   clock_t start, end;
 
   //send init message
@@ -36,17 +37,13 @@ int main(int argc, char **argv)
 
     //write 5x5 feature map in mem0
     for (i = 0; i < 25; i++)
-    {
       pixels[25 * j + i] = rand() % 50 - 25;
-      stage[j].memA[0].write(i, pixels[25 * j + i]);
-    }
+    stage[j].memA[0].write_block(0, &pixels[25 * j], 25);
 
     //write 3x3 kernel and bias in mem1
     for (i = 0; i < 9; i++)
-    {
       weights[9 * j + i] = rand() % 10 - 5;
-      stage[j].memA[1].write(i, weights[9 * j + i]);
-    }
+    stage[j].memA[1].write_block(0, &weights[9 * j], 9);
 
     //write bias after weights of VERSAT 0
     if (j == 0)
@@ -149,14 +146,13 @@ int main(int argc, char **argv)
         stage[k].memA[0].setStart(i * 5 + j);
       stage[nSTAGE - 1].memA[2].setStart(i * 3 + j);
 
-      //run configurations
+      //queue run (configuration is snapshotted, so the next
+      //start values can be set while this run is simulating)
       run();
-
-      //wait until done is done
-      while (done() == 0)
-        ;
     }
   }
+  //wait until all runs are done
+  wait();
   end = clock();
   printf("\n3D convolution done in %ld us\n", (end - start));
   printf("Simulation took %d Versat Clock Cycles\n", versat_iter);
@@ -233,8 +229,7 @@ int main(int argc, char **argv)
   //perform convolution
   start = clock();
   run();
-  while (done() == 0)
-    ;
+  wait();
   end = clock();
   printf("\n3D convolution done in %ld us\n", (end - start));
   printf("Simulation took %d Versat Clock Cycles\n", versat_iter);
@@ -13,7 +13,7 @@ if len(sys.argv) < 3:
     sys.exit()
 
 #List with defines to ignore
-ignore_list = ["FNS_W", "_BITS", "0_B", "A_B", "PERIOD_W", "DATABUS_W", "SHIFT_W"]
+ignore_list = ["0_B", "A_B", "DATABUS_W"]
 
 #List with .vh already processed (to avoid duplicates). First to be read is the one considered
 include_list = []
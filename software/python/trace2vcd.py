@@ -0,0 +1,95 @@
+#!/usr/bin/python
+#Description: converts a binary cycle trace of the PC simulator (trace.hpp) to VCD
+#Arguments: trace file, VCD file, clock period and time of cycle 0 in ns
+
+#Import libraries
+import struct
+import sys
+
+#Check command line arguments
+if len(sys.argv) < 3:
+    print("Usage: python trace2vcd.py <trace_file> <vcd_file> [clk_per] [offset]")
+    sys.exit()
+
+#clk_per of xversat_tb.v, so both waveforms share the time axis
+clk_per = int(sys.argv[3]) if len(sys.argv) > 3 else 10
+offset = int(sys.argv[4]) if len(sys.argv) > 4 else 0
+
+data = open(sys.argv[1], "rb").read()
+
+#Header and signal table (CTraceHeader, CTraceSignal)
+magic, version, datapath_w, n_signals, reserved = struct.unpack_from("<8sIIII", data, 0)
+if magic != b"VERSATTR" or version != 1:
+    print("Not a Versat trace: " + sys.argv[1])
+    sys.exit(1)
+pos = 24
+signals = []
+for i in range(n_signals):
+    stage, sel, name = struct.unpack_from("<HH12s", data, pos)
+    signals.append((stage, sel, name.split(b"\0")[0].decode()))
+    pos += 16
+
+#LEB128 varint at pos
+def get():
+    global pos
+    v = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if b < 0x80:
+            return v
+
+#VCD identifier of signal i
+def ident(i):
+    s = ""
+    while True:
+        s += chr(33 + i % 94)
+        i //= 94
+        if i == 0:
+            return s
+
+mask = (1 << datapath_w) - 1
+def value(v):
+    return "b" + format(v & mask, "b") + " "
+
+vcd = open(sys.argv[2], "w")
+vcd.write("$timescale 1ns $end\n")
+vcd.write("$scope module versat $end\n")
+stage = -1
+for i, (s, sel, name) in enumerate(signals):
+    if s != stage:
+        if stage >= 0:
+            vcd.write("$upscope $end\n")
+        vcd.write("$scope module stage" + str(s) + " $end\n")
+        stage = s
+    vcd.write("$var wire " + str(datapath_w) + " " + ident(i) + " " + name + " $end\n")
+if stage >= 0:
+    vcd.write("$upscope $end\n")
+vcd.write("$upscope $end\n$enddefinitions $end\n")
+
+#all signals start at 0
+vcd.write("#" + str(offset) + "\n$dumpvars\n")
+for i in range(n_signals):
+    vcd.write(value(0) + ident(i) + "\n")
+vcd.write("$end\n")
+
+#Records
+values = [0] * n_signals
+time = 0
+stamp = offset
+while pos < len(data):
+    time += get()
+    n = get()
+    if offset + time * clk_per != stamp:
+        stamp = offset + time * clk_per
+        vcd.write("#" + str(stamp) + "\n")
+    i = 0
+    for c in range(n):
+        i += get()
+        d = get()
+        values[i] += (d >> 1) ^ -(d & 1)
+        vcd.write(value(values[i]) + ident(i) + "\n")
+vcd.close()
@@ -0,0 +1,161 @@
+#!/usr/bin/python
+#Description: ctypes binding of libversat_sim.so (software/pc/lib/versat_sim.h)
+#Memory banks are returned as NumPy arrays on the simulated memory, no copies
+
+#Import libraries
+import ctypes
+import numpy as np
+
+ABI_VERSION = 1
+
+#FU kinds of Versat.sel()
+MEMA, MEMB, VI, ALU, ALULITE, MUL, MULADD, BS = range(8)
+
+#Signatures of the C interface
+_p = ctypes.c_void_p
+_i = ctypes.c_int
+_s = ctypes.c_char_p
+_sigs = {
+    "versat_sim_abi_version": (_i, []),
+    "versat_sim_word_size": (_i, []),
+    "versat_sim_param": (_i, [_s]),
+    "versat_sim_create": (_p, []),
+    "versat_sim_destroy": (None, [_p]),
+    "versat_sim_load_topology": (_i, [_p, _s]),
+    "versat_sim_set_engine": (_i, [_p, _i]),
+    "versat_sim_set_threads": (_i, [_p, _i]),
+    "versat_sim_conf_write": (_i, [_p, _i, _i, _i]),
+    "versat_sim_conf_read": (_i, [_p, _i, _i, ctypes.POINTER(_i)]),
+    "versat_sim_sel": (_i, [_p, _i, _i, _i]),
+    "versat_sim_mem": (_p, [_p, _i, _i]),
+    "versat_sim_mem_size": (_i, [_p]),
+    "versat_sim_set_ext_mem": (_i, [_p, _p, ctypes.c_uint32]),
+    "versat_sim_run": (_i, [_p]),
+    "versat_sim_done": (_i, [_p]),
+    "versat_sim_wait": (_i, [_p]),
+    "versat_sim_save_conf": (_i, [_p, _s]),
+    "versat_sim_load_conf": (_i, [_p, _s]),
+    "versat_sim_save_checkpoint": (_i, [_p, _s]),
+    "versat_sim_load_checkpoint": (_i, [_p, _s]),
+    "versat_sim_save_run_stats": (_i, [_p, _s]),
+}
+
+class Library:
+    """One build of the simulator (one versat.h)"""
+
+    def __init__(self, path="libversat_sim.so"):
+        self.lib = ctypes.CDLL(path)
+        for name, (res, args) in _sigs.items():
+            f = getattr(self.lib, name)
+            f.restype = res
+            f.argtypes = args
+        if self.lib.versat_sim_abi_version() != ABI_VERSION:
+            raise RuntimeError("ABI version mismatch: " + path)
+        #signed datapath words
+        self.dtype = {1: np.int8, 2: np.int16, 4: np.int32}[self.lib.versat_sim_word_size()]
+
+    #constant of the build (nSTAGE, CONF_ALU0, MEMP_CONF_ITER ...)
+    def param(self, name):
+        val = self.lib.versat_sim_param(name.encode())
+        if val < 0:
+            raise KeyError(name)
+        return val
+
+    def create(self):
+        return Versat(self)
+
+class Versat:
+    """One simulated Versat"""
+
+    def __init__(self, library):
+        self.library = library
+        self.lib = library.lib
+        self.v = self.lib.versat_sim_create()
+        if not self.v:
+            raise MemoryError("versat_sim_create")
+        self.ext_mem = None
+
+    def close(self):
+        if self.v:
+            self.lib.versat_sim_destroy(self.v)
+            self.v = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def _check(self, ret, what):
+        if ret != 0:
+            raise RuntimeError(what)
+
+    def load_topology(self, path):
+        self._check(self.lib.versat_sim_load_topology(self.v, path.encode()), path)
+
+    def set_engine(self, engine):
+        self._check(self.lib.versat_sim_set_engine(self.v, engine), "engine")
+
+    def set_threads(self, n):
+        self._check(self.lib.versat_sim_set_threads(self.v, n), "threads")
+
+    #configuration register addr of stage, as the firmware writes it
+    def conf_write(self, stage, addr, val):
+        self._check(self.lib.versat_sim_conf_write(self.v, stage, addr, val), "conf addr %d" % addr)
+
+    def conf_read(self, stage, addr):
+        val = ctypes.c_int()
+        self._check(self.lib.versat_sim_conf_read(self.v, stage, addr, ctypes.byref(val)), "conf addr %d" % addr)
+        return val.value
+
+    #databus selector of FU index of kind (MEMA ...), prev for the previous stage
+    def sel(self, kind, index, prev=False):
+        return self.lib.versat_sim_sel(self.v, kind, index, int(prev))
+
+    #memory m of stage s, an array on the simulated memory: wait() before use
+    #the array keeps this instance alive; after close() it must not be used
+    def mem(self, s, m):
+        ptr = self.lib.versat_sim_mem(self.v, s, m)
+        if not ptr:
+            raise IndexError("mem %d of stage %d" % (m, s))
+        n = self.lib.versat_sim_mem_size(self.v)
+        buf = (np.ctypeslib.as_ctypes_type(self.library.dtype) * n).from_address(ptr)
+        buf._owner = self
+        return np.ctypeslib.as_array(buf)
+
+    #array used as the external memory of the VI/VO, kept alive here
+    def set_ext_mem(self, array):
+        array = np.ascontiguousarray(array, dtype=self.library.dtype)
+        self._check(self.lib.versat_sim_set_ext_mem(self.v, array.ctypes.data, array.size), "ext mem")
+        self.ext_mem = array
+        return array
+
+    def run(self):
+        self.lib.versat_sim_run(self.v)
+
+    #True when all queued runs have finished, also before the first run
+    def done(self):
+        return self.lib.versat_sim_done(self.v) != 0
+
+    #wait for the queued runs, return the clock cycles of the last one
+    def wait(self):
+        return self.lib.versat_sim_wait(self.v)
+
+    #configuration of all stages as packed configuration registers
+    def save_conf(self, path):
+        self._check(self.lib.versat_sim_save_conf(self.v, path.encode()), path)
+
+    def load_conf(self, path):
+        self._check(self.lib.versat_sim_load_conf(self.v, path.encode()), path)
+
+    def save_checkpoint(self, path):
+        self._check(self.lib.versat_sim_save_checkpoint(self.v, path.encode()), path)
+
+    def load_checkpoint(self, path):
+        self._check(self.lib.versat_sim_load_checkpoint(self.v, path.encode()), path)
+
+    def save_run_stats(self, path):
+        self._check(self.lib.versat_sim_save_run_stats(self.v, path.encode()), path)